@@ -1,3 +1,5 @@
+#pragma once
+
 // Bjorklund s algorithm for euclidean sequences
 //
 // Modified GIST from https://gist.github.com/unohee/d4f32b3222b42de84a5f
@@ -1,10 +1,31 @@
 #include "Catatumbo.hpp"
+#include <unordered_map>
 
 Plugin *pluginInstance;
 
+// Cachés perezosas de recursos: sólo se tocan desde el hilo de la interfaz
+std::shared_ptr<Svg> pluginSvg(const std::string& path) {
+  static std::unordered_map<std::string, std::shared_ptr<Svg>> cache;
+  std::shared_ptr<Svg>& svg = cache[path];
+  if (!svg) {
+    svg = APP->window->loadSvg(asset::plugin(pluginInstance, path));
+  }
+  return svg;
+}
+
+const std::string& pluginFont(const std::string& path) {
+  static std::unordered_map<std::string, std::string> cache;
+  std::string& resolved = cache[path];
+  if (resolved.empty()) {
+    resolved = asset::plugin(pluginInstance, path);
+  }
+  return resolved;
+}
+
 void init(rack::Plugin *p) {
   pluginInstance = p;
 
   p->addModel(modelPuya);
+  p->addModel(modelPuyaExpander);
 
 }
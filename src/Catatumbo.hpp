@@ -5,12 +5,21 @@ using namespace rack;
 extern Plugin *pluginInstance;
 
 extern Model *modelPuya;
+extern Model *modelPuyaExpander;
+
+// Recursos compartidos del plugin (definidos en Catatumbo.cpp). Cada SVG se
+// resuelve y se carga la primera vez que un widget lo pide y luego se
+// comparte entre todas las instancias. De las fuentes sólo se guarda la
+// ruta resuelta: NanoVG obliga a pedirlas en draw() y loadFont ya las
+// cachea por ruta.
+std::shared_ptr<Svg> pluginSvg(const std::string& path);
+const std::string& pluginFont(const std::string& path);
 
 // GUI COMPONENTS
 
 struct PJ301MAqua : app::SvgPort {
   PJ301MAqua() {
-    setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/PJ301MAqua.svg")));
+    setSvg(pluginSvg("res/PJ301MAqua.svg"));
   }
 };
 
@@ -23,14 +32,14 @@ struct SmallPB61303 : PB61303 {
 
 struct sp_Port : app::SvgPort {
   sp_Port() {
-    setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/sp-Port20.svg")));
+    setSvg(pluginSvg("res/sp-Port20.svg"));
   }
 };
 
 struct sp_Switch : app::SvgSwitch {
   sp_Switch() {
-    addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/sp-switchv_0.svg")));
-    addFrame(APP->window->loadSvg(asset::plugin(pluginInstance, "res/sp-switchv_1.svg")));
+    addFrame(pluginSvg("res/sp-switchv_0.svg"));
+    addFrame(pluginSvg("res/sp-switchv_1.svg"));
   }
 };
 
@@ -38,7 +47,7 @@ struct sp_Encoder : app::SvgKnob {
   sp_Encoder() {
     minAngle = -1.0f * M_PI;
     maxAngle = 1.0f * M_PI;
-    setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/sp-encoder.svg")));
+    setSvg(pluginSvg("res/sp-encoder.svg"));
     //sw->svg = APP->window->loadSvg(asset::plugin(pluginInstance, "res/sp-encoder.svg"));
     //sw->wrap();
     //box.size = sw->box.size;
@@ -49,7 +58,7 @@ struct sp_BlackKnob : app::SvgKnob {
   sp_BlackKnob() {
     minAngle = -0.83 * M_PI;
     maxAngle = 0.83 * M_PI;
-    setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/sp-knobBlack-large.svg")));
+    setSvg(pluginSvg("res/sp-knobBlack-large.svg"));
     box.size = Vec(30, 30);
   }
 };
@@ -58,7 +67,7 @@ struct sp_SmallBlackKnob : app::SvgKnob {
   sp_SmallBlackKnob() {
     minAngle = -0.83 * M_PI;
     maxAngle = 0.83 * M_PI;
-    setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/sp-knobBlack.svg")));
+    setSvg(pluginSvg("res/sp-knobBlack.svg"));
     //sw->svg = APP->window->loadSvg(asset::plugin(pluginInstance, "res/sp-knobBlack.svg"));
     //sw->wrap();
     //box.size = Vec(20,20);
@@ -69,9 +78,70 @@ struct sp_Trimpot : app::SvgKnob {
   sp_Trimpot() {
     minAngle = -0.83 * M_PI;
     maxAngle = 0.83 * M_PI;
-    setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/sp-trimpotBlack.svg")));
+    setSvg(pluginSvg("res/sp-trimpotBlack.svg"));
     //sw->svg = APP->window->loadSvg(asset::plugin(pluginInstance, "res/sp-knobBlack.svg"));
     //sw->wrap();
     //box.size = Vec(18,18);
   }
 };
+
+// Rótulo de texto para las secciones del panel sin serigrafía SVG
+struct PanelLabel : TransparentWidget {
+  std::string text;
+  NVGcolor color = nvgRGB(0xb7, 0xff, 0xff);
+  float fontSize = 7.0f;
+
+  void draw(const DrawArgs& args) override {
+    std::shared_ptr<Font> font = APP->window->loadFont(pluginFont("res/DejaVuSansMono.ttf"));
+    if (!font) return;
+    nvgFontSize(args.vg, fontSize);
+    nvgFontFaceId(args.vg, font->handle);
+    nvgTextAlign(args.vg, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
+    nvgFillColor(args.vg, color);
+    nvgText(args.vg, box.size.x / 2.0f, box.size.y / 2.0f, text.c_str(), nullptr);
+  }
+};
+
+inline PanelLabel* createPanelLabel(Vec center, const std::string& text) {
+  PanelLabel* label = new PanelLabel;
+  label->box.size = Vec(30.0f, 8.0f);
+  label->box.pos = center.minus(label->box.size.div(2.0f));
+  label->text = text;
+  return label;
+}
+
+// Cantidad para editar un float del módulo con un ui::Slider del menú
+struct FloatPtrQuantity : Quantity {
+  float* ptr = nullptr;
+  float minValue = 0.0f;
+  float maxValue = 1.0f;
+  float defaultValue = 1.0f;
+  float displayMultiplier = 100.0f;
+  std::string label;
+  std::string unit = "%";
+
+  void setValue(float value) override { *ptr = clamp(value, minValue, maxValue); }
+  float getValue() override { return *ptr; }
+  float getMinValue() override { return minValue; }
+  float getMaxValue() override { return maxValue; }
+  float getDefaultValue() override { return defaultValue; }
+  float getDisplayValue() override { return getValue() * displayMultiplier; }
+  void setDisplayValue(float displayValue) override { setValue(displayValue / displayMultiplier); }
+  int getDisplayPrecision() override { return 3; }
+  std::string getLabel() override { return label; }
+  std::string getUnit() override { return unit; }
+};
+
+struct FloatPtrSlider : ui::Slider {
+  FloatPtrSlider(float* ptr, const std::string& label, float defaultValue = 1.0f) {
+    FloatPtrQuantity* q = new FloatPtrQuantity;
+    q->ptr = ptr;
+    q->label = label;
+    q->defaultValue = defaultValue;
+    quantity = q;
+    box.size.x = 200.0f;
+  }
+  ~FloatPtrSlider() {
+    delete quantity;
+  }
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+// Catálogo de collares rítmicos binarios
+//
+// Enumera una sola vez todos los collares binarios de longitud 1..MAX_LEN
+// (patrones equivalentes bajo rotación) con el algoritmo FKM, que los
+// produce directamente en forma canónica. La forma canónica es la rotación
+// que empieza por el grupo de hits más largo, de modo que todo collar
+// salvo el vacío empieza con un hit en la posición 0.
+//
+// Cada collar ocupa una palabra: bits 0-23 = pasos (bit i = paso i),
+// bits 24-31 = longitud. El ID es la posición en la tabla (ordenada por
+// longitud y, dentro de cada longitud, lexicográficamente con los hits
+// primero: el primero es el lleno y el último el vacío), así que
+// ID -> patrón y (longitud, índice) -> ID son consultas O(1).
+
+#include <cstdint>
+#include <vector>
+
+template <unsigned int MAX_LEN>
+struct NecklaceCatalog {
+    static_assert(MAX_LEN >= 1 && MAX_LEN <= 24, "el catálogo admite hasta 24 pasos");
+
+    static const unsigned int STEP_BITS = 24;
+    static const uint32_t STEP_MASK = (1u << STEP_BITS) - 1;
+
+    std::vector<uint32_t> table;
+    uint32_t offset[MAX_LEN + 2];  // offset[n] = primer ID de longitud n
+
+    NecklaceCatalog() {
+        offset[0] = offset[1] = 0;
+        for (unsigned int n = 1; n <= MAX_LEN; n++) {
+            generate(n);
+            offset[n + 1] = table.size();
+        }
+    }
+
+    uint32_t size() const { return table.size(); }
+
+    // Collares de longitud n
+    uint32_t count(unsigned int n) const { return offset[n + 1] - offset[n]; }
+
+    uint32_t id(unsigned int n, uint32_t index) const { return offset[n] + index; }
+
+    // Perilla/CV normalizado (0-1) -> ID dentro de la longitud n
+    uint32_t select(unsigned int n, float x) const {
+        return offset[n] + static_cast<uint32_t>((count(n) - 1) * x);
+    }
+
+    uint32_t steps(uint32_t id) const { return table[id] & STEP_MASK; }
+    unsigned int length(uint32_t id) const { return table[id] >> STEP_BITS; }
+    unsigned int hits(uint32_t id) const { return __builtin_popcount(steps(id)); }
+
+private:
+    // FKM: recorre los precollares en orden lexicográfico y emite los que
+    // son collares de longitud n (periodo p divide a n). Se enumera la
+    // palabra de silencios (0 = hit) para que el orden lexicográfico
+    // ponga los hits primero.
+    void generate(unsigned int n) {
+        unsigned int a[MAX_LEN + 1] = {};
+        unsigned int p = 1;
+        for (;;) {
+            if (n % p == 0) {
+                uint32_t bits = 0;
+                for (unsigned int i = 0; i < n; i++) {
+                    if (!a[i + 1]) bits |= 1u << i;
+                }
+                table.push_back(bits | (n << STEP_BITS));
+            }
+
+            unsigned int i = n;
+            while (i > 0 && a[i] == 1) i--;
+            if (i == 0) break;
+            a[i] = 1;
+            p = i;
+            for (unsigned int j = i + 1; j <= n; j++) {
+                a[j] = a[j - p];
+            }
+        }
+    }
+};
@@ -0,0 +1,167 @@
+#include "PatternBank.hpp"
+#include "WidePath.hpp"
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool PatternFile::open(const std::string& path) {
+  close();
+
+#ifdef _WIN32
+  std::wstring wpath = widePath(path);
+  if (wpath.empty()) return false;
+  HANDLE f = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (f == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(f, &size) || size.QuadPart == 0) {
+    CloseHandle(f);
+    return false;
+  }
+  HANDLE m = CreateFileMappingW(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!m) {
+    CloseHandle(f);
+    return false;
+  }
+  void* view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+  if (!view) {
+    CloseHandle(m);
+    CloseHandle(f);
+    return false;
+  }
+  file = f;
+  mapping = m;
+  data = static_cast<const char*>(view);
+  bytes = static_cast<size_t>(size.QuadPart);
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);  // la proyección sigue válida sin el descriptor
+  if (view == MAP_FAILED) return false;
+  madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+  data = static_cast<const char*>(view);
+  bytes = static_cast<size_t>(st.st_size);
+#endif
+
+  // Índice disperso: una posición cada INDEX_STRIDE entradas
+  const char* end = data + bytes;
+  for (const char* p = data; p < end;) {
+    const char* e = lineEnd(p);
+    if (isEntry(p, e)) {
+      if (count % INDEX_STRIDE == 0) offsets.push_back(p - data);
+      count++;
+    }
+    p = e + 1;
+  }
+  filePath = path;
+  return true;
+}
+
+void PatternFile::close() {
+  if (data) {
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(static_cast<HANDLE>(mapping));
+    CloseHandle(static_cast<HANDLE>(file));
+    file = mapping = nullptr;
+#else
+    munmap(const_cast<char*>(data), bytes);
+#endif
+  }
+  data = nullptr;
+  bytes = 0;
+  count = 0;
+  filePath.clear();
+  offsets.clear();
+  cache.clear();
+}
+
+const PatternEntry* PatternFile::entry(size_t index) {
+  const Cached* cached = lookup(index);
+  return cached ? &cached->entry : nullptr;
+}
+
+std::string PatternFile::name(size_t index) {
+  const Cached* cached = lookup(index);
+  return cached ? cached->name : std::string();
+}
+
+const char* PatternFile::lineEnd(const char* p) const {
+  const char* e = static_cast<const char*>(std::memchr(p, '\n', data + bytes - p));
+  return e ? e : data + bytes;
+}
+
+bool PatternFile::isEntry(const char* p, const char* end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+  return p < end && *p != '#';
+}
+
+// Salta desde la entrada indexada más cercana hasta la pedida
+const PatternFile::Cached* PatternFile::lookup(size_t index) {
+  if (index >= count) return nullptr;
+  auto it = cache.find(index);
+  if (it != cache.end()) return &it->second;
+
+  const char* end = data + bytes;
+  const char* p = data + offsets[index / INDEX_STRIDE];
+  size_t skip = index % INDEX_STRIDE;
+  for (;;) {
+    const char* e = lineEnd(p);
+    if (isEntry(p, e)) {
+      if (skip == 0) {
+        Cached& cached = cache[index];
+        parse(p, e, cached);
+        return &cached;
+      }
+      skip--;
+    }
+    if (e >= end) return nullptr;
+    p = e + 1;
+  }
+}
+
+// Patrón: hasta el primer espacio; los caracteres desconocidos se ignoran
+const char* PatternEntry::parse(const char* p, const char* end) {
+  for (; p < end && *p != ' ' && *p != '\t' && *p != '\r'; p++) {
+    if (length >= MAX_STEPS) continue;
+    unsigned int i = length;
+    uint64_t bit = uint64_t(1) << (i % 64);
+    switch (*p) {
+      case 'X':
+        accents[i / 64] |= bit;
+        // fallthrough
+      case 'x':
+        sequence[i / 64] |= bit;
+        // fallthrough
+      case '.':
+      case '-':
+        length++;
+        break;
+      default:
+        break;
+    }
+  }
+  return p;
+}
+
+void PatternFile::parse(const char* p, const char* end, Cached& cached) {
+  while (p < end && (*p == ' ' || *p == '\t')) p++;
+  p = cached.entry.parse(p, end);
+
+  // Nombre: el resto de la línea sin espacios alrededor
+  while (p < end && (*p == ' ' || *p == '\t')) p++;
+  const char* e = end;
+  while (e > p && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')) e--;
+  cached.name.assign(p, e);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+// Bancos de patrones en archivos de texto
+//
+// Cada línea del archivo es una entrada: el patrón y, opcionalmente, un
+// nombre separado por espacios.
+//
+//   x..x..x.|..X..X..   Culo e' puya (prima)
+//
+// 'x' es un hit, 'X' un hit acentuado, '.' o '-' un silencio y '|' separa
+// compases (se ignora). Las líneas vacías y las que empiezan con '#' no
+// cuentan como entradas.
+//
+// PatternFile proyecta el archivo en memoria y al abrirlo sólo recorre los
+// saltos de línea para guardar la posición de una de cada INDEX_STRIDE
+// entradas. Una entrada se interpreta la primera vez que se pide y queda
+// en caché, así que la memoria crece con las entradas usadas. Se usa sólo
+// desde el hilo de la interfaz.
+//
+// PatternBankSlot lleva una entrada de ese hilo al de audio sin locks: la
+// interfaz escribe las palabras bajo un contador de versión (seqlock) y el
+// hilo de audio sólo acepta la copia si la versión no cambió entre medias.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct PatternEntry {
+    static const unsigned int MAX_STEPS = 128;
+    static const unsigned int WORDS = MAX_STEPS / 64;
+
+    uint64_t sequence[WORDS] = {};   // bit i = hit en el paso i
+    uint64_t accents[WORDS] = {};
+    unsigned int length = 0;         // 0 = línea sin pasos
+
+    // Lee los pasos desde p hasta el primer espacio (o end) y devuelve
+    // dónde terminó; sirve también para patrones escritos a mano
+    const char* parse(const char* p, const char* end);
+};
+
+class PatternFile {
+public:
+    static const size_t INDEX_STRIDE = 64;
+
+    PatternFile() {}
+    ~PatternFile() { close(); }
+
+    PatternFile(const PatternFile&) = delete;
+    PatternFile& operator=(const PatternFile&) = delete;
+
+    // Proyecta el archivo y cuenta sus entradas; false si no se pudo abrir
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+    const std::string& path() const { return filePath; }
+    size_t size() const { return count; }
+
+    // Entrada index interpretada (nullptr fuera de rango) y su nombre
+    const PatternEntry* entry(size_t index);
+    std::string name(size_t index);
+
+private:
+    struct Cached {
+        PatternEntry entry;
+        std::string name;
+    };
+
+    const char* data = nullptr;
+    size_t bytes = 0;
+    size_t count = 0;
+    std::string filePath;
+    std::vector<size_t> offsets;    // inicio de las entradas 0, STRIDE, 2*STRIDE...
+    std::unordered_map<size_t, Cached> cache;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+
+    const char* lineEnd(const char* p) const;
+    static bool isEntry(const char* p, const char* end);
+    const Cached* lookup(size_t index);
+    static void parse(const char* p, const char* end, Cached& cached);
+};
+
+struct PatternBankSlot {
+    static const unsigned int WORDS = PatternEntry::WORDS;
+
+    std::atomic<int32_t> requested;  // audio -> interfaz (-1 = ninguna)
+    std::atomic<uint32_t> version;   // impar mientras la interfaz escribe
+    std::atomic<int32_t> index;      // entrada publicada (-1 = ninguna)
+    std::atomic<uint32_t> length;
+    std::atomic<uint64_t> sequence[WORDS];
+    std::atomic<uint64_t> accents[WORDS];
+
+    PatternBankSlot() {
+        requested.store(-1, std::memory_order_relaxed);
+        version.store(0, std::memory_order_relaxed);
+        index.store(-1, std::memory_order_relaxed);
+        length.store(0, std::memory_order_relaxed);
+        for (unsigned int i = 0; i < WORDS; i++) {
+            sequence[i].store(0, std::memory_order_relaxed);
+            accents[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Interfaz: publica la entrada i (-1 invalida la publicada)
+    void publish(int32_t i, const PatternEntry& entry) {
+        uint32_t v = version.load(std::memory_order_relaxed);
+        version.store(v + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        index.store(i, std::memory_order_relaxed);
+        length.store(entry.length, std::memory_order_relaxed);
+        for (unsigned int w = 0; w < WORDS; w++) {
+            sequence[w].store(entry.sequence[w], std::memory_order_relaxed);
+            accents[w].store(entry.accents[w], std::memory_order_relaxed);
+        }
+        version.store(v + 2, std::memory_order_release);
+    }
+
+    int32_t published() const {
+        return index.load(std::memory_order_acquire);
+    }
+
+    // Audio: copia la entrada i si es la publicada; false si no lo es o si
+    // la interfaz la estaba reescribiendo (se reintenta más tarde)
+    bool read(int32_t i, PatternEntry& out) const {
+        uint32_t v = version.load(std::memory_order_acquire);
+        if (v & 1) return false;
+        if (index.load(std::memory_order_relaxed) != i) return false;
+        out.length = length.load(std::memory_order_relaxed);
+        for (unsigned int w = 0; w < WORDS; w++) {
+            out.sequence[w] = sequence[w].load(std::memory_order_relaxed);
+            out.accents[w] = accents[w].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return version.load(std::memory_order_relaxed) == v;
+    }
+};
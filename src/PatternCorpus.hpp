@@ -0,0 +1,633 @@
+#pragma once
+
+// Corpus dorado de los generadores de patrones de Puya
+//
+// Congela la salida actual de Bjorklund::iter, generateFibonacciPattern,
+// generateLinearPattern y distributeAccents para las combinaciones
+// (l, k, a, s, r, p) alcanzables desde updateVoiceParameters con cada
+// longitud máxima (32, 64 y 128 pasos: l <= máximo / 2, l + p <= máximo).
+// Cada ancho, estilo y longitud guarda un resumen (cantidad de tuplas + hash
+// FNV-1a de 64 bits) y verify() compara cualquier implementación
+// alternativa contra ese resumen; si hay diferencias, la referencia
+// congelada localiza la primera tupla distinta.
+//
+// Con 32 pasos se recorren todas las tuplas. Con 64 y 128 el barrido
+// completo tiene miles de millones: se recorren todas las (l, k, a) y, de
+// s, r y p, los extremos y el punto medio.
+
+#include "Bjorklund.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace corpus {
+
+// Longitudes máximas del corpus (par_l + par_p); par_l llega a la mitad
+static const unsigned NUM_WIDTHS = 3;
+static const unsigned WIDTHS[NUM_WIDTHS] = {32, 64, 128};
+static const unsigned CORPUS_LEN = 128;
+static const unsigned CORPUS_MAX_L = CORPUS_LEN / 2;
+static const unsigned PATTERN_WORDS = CORPUS_LEN / 32;
+
+inline unsigned int widthIndex(unsigned int width) {
+    return (width <= 32) ? 0 : (width <= 64) ? 1 : 2;
+}
+
+// Estilos deterministas (el aleatorio queda fuera del corpus)
+enum Style {
+    EUCLIDEAN,
+    FIBONACCI,
+    LINEAR,
+    NUM_STYLES
+};
+
+struct Tuple {
+    unsigned int l, k, a, s, r, p;
+};
+
+// Secuencia y acentos empaquetados en palabras de 32 bits: bit i = paso i
+struct Pattern {
+    uint32_t seq[PATTERN_WORDS];
+    uint32_t acc[PATTERN_WORDS];
+
+    void set(uint32_t* words, unsigned int i) { words[i / 32] |= 1u << (i % 32); }
+
+    bool operator==(const Pattern& o) const {
+        for (unsigned int i = 0; i < PATTERN_WORDS; i++) {
+            if (seq[i] != o.seq[i] || acc[i] != o.acc[i]) return false;
+        }
+        return true;
+    }
+    bool operator!=(const Pattern& o) const { return !(*this == o); }
+};
+
+struct Digest {
+    uint32_t count;
+    uint64_t hash;
+};
+
+struct Mismatch {
+    unsigned int width;
+    Style style;
+    Tuple tuple;
+    Pattern expected;
+    Pattern actual;
+};
+
+// Copia congelada de los generadores tal como estaban en Puya.cpp.
+// No optimizar: es la definición de "bit-idéntico".
+namespace reference {
+
+// Iterativa: los mismos valores (módulo 2^32) que la versión recursiva
+// original, que con k de hasta 64 no termina
+inline unsigned int fib(unsigned int n) {
+    unsigned int a = 0, b = 1;
+    for (unsigned int i = 0; i < n; i++) {
+        unsigned int t = a + b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+inline void generate(Style style, unsigned int l, unsigned int k, unsigned int a,
+                     std::vector<bool>& seq0, std::vector<bool>& acc0) {
+    switch (style) {
+        case EUCLIDEAN: {
+            Bjorklund euclid;
+            euclid.init(l, k);
+            euclid.iter();
+            seq0 = euclid.sequence;
+            acc0.clear();
+            if (a > 0) {
+                Bjorklund euclid2;
+                euclid2.init(k, a);
+                euclid2.iter();
+                acc0 = euclid2.sequence;
+            }
+            break;
+        }
+        case FIBONACCI:
+            seq0.assign(l, false);
+            for (unsigned int i = 0; i < k; i++) seq0.at(fib(i) % l) = true;
+            acc0.assign(k, false);
+            for (unsigned int i = 0; i < a; i++) acc0.at(fib(i) % k) = true;
+            break;
+        case LINEAR:
+            seq0.assign(l, false);
+            for (unsigned int i = 0; i < k; i++) seq0.at(l * i / k) = true;
+            acc0.assign(k, false);
+            for (unsigned int i = 0; i < a; i++) acc0.at(k * i / a) = true;
+            break;
+        default:
+            break;
+    }
+}
+
+// distributeAccents sobre un estado recién reiniciado (sequence/accents en cero)
+inline Pattern distribute(const Tuple& t, const std::vector<bool>& seq0, const std::vector<bool>& acc0) {
+    Pattern out = {};
+    unsigned int j = t.k - t.s;
+    for (unsigned int i = 0; i < seq0.size(); i++) {
+        unsigned int idx = (i + t.r) % (t.l + t.p);
+        if (seq0.at(i)) {
+            out.set(out.seq, idx);
+            if (t.a) {
+                if (acc0.at(j % t.k)) out.set(out.acc, idx);
+                j++;
+            }
+        }
+    }
+    return out;
+}
+
+inline Pattern render(Style style, const Tuple& t) {
+    std::vector<bool> seq0, acc0;
+    generate(style, t.l, t.k, t.a, seq0, acc0);
+    return distribute(t, seq0, acc0);
+}
+
+} // namespace reference
+
+// Valores de un parámetro entre 0 y max: todos con el barrido completo, o
+// los extremos y el punto medio
+template <typename F>
+inline void forEachValue(unsigned int max, bool full, F f) {
+    for (unsigned int x = 0; x <= max; x++) {
+        if (full || x == 0 || x == max / 2 || x == max) f(x);
+    }
+}
+
+// Recorre las tuplas del ancho width con par_l == l en el orden del mapeo
+// de updateVoiceParameters: p, r, k, a, s.
+template <typename F>
+inline void forEachTuple(unsigned int width, unsigned int l, F f) {
+    bool full = (width <= 32);
+    Tuple t;
+    t.l = l;
+    forEachValue(width - l, full, [&](unsigned int p) {
+        t.p = p;
+        forEachValue(t.l + t.p - 1, full, [&](unsigned int r) {
+            t.r = r;
+            for (t.k = 1; t.k <= l; t.k++) {
+                for (t.a = 0; t.a <= t.k; t.a++) {
+                    unsigned int sMax = t.a ? t.k - 1 : 0;
+                    forEachValue(sMax, full, [&](unsigned int s) {
+                        t.s = s;
+                        f(t);
+                    });
+                }
+            }
+        });
+    });
+}
+
+inline void hashWord(uint64_t& h, uint32_t w) {
+    for (int b = 0; b < 4; b++) {
+        h ^= (w >> (8 * b)) & 0xffu;
+        h *= 0x100000001b3ull;
+    }
+}
+
+// Resumen de un generador para un ancho, un estilo y una longitud. Se
+// resumen las palabras del ancho (con 32 pasos, una de secuencia y una de
+// acentos).
+// Generator: Pattern gen(Style, const Tuple&)
+template <typename Generator>
+inline Digest digest(Generator& gen, unsigned int width, Style style, unsigned int l) {
+    Digest d = {0, 0xcbf29ce484222325ull};
+    unsigned int words = width / 32;
+    forEachTuple(width, l, [&](const Tuple& t) {
+        Pattern pat = gen(style, t);
+        for (unsigned int i = 0; i < words; i++) hashWord(d.hash, pat.seq[i]);
+        for (unsigned int i = 0; i < words; i++) hashWord(d.hash, pat.acc[i]);
+        d.count++;
+    });
+    return d;
+}
+
+// Resúmenes producidos por reference::render, uno por ancho.
+// Regenerar con printGolden(ancho, reference::render) sólo si el cambio de
+// salida es intencional.
+static const Digest GOLDEN_32[NUM_STYLES][16] = {
+    {
+        {   1056, 0xce6020dd131c6d9dull},
+        {   3689, 0xcb528c1c746be8d4ull},
+        {   8925, 0x9c3bea79c1fc628full},
+        {  17748, 0x1cda5a053a1eaed8ull},
+        {  31080, 0xbf77f570c75d2725ull},
+        {  49761, 0xdfc7e737ed477d05ull},
+        {  74529, 0x0a7c996df7c34a05ull},
+        { 106000, 0xcb8a6b397debdc5dull},
+        { 144648, 0x9aa948f36295fd43ull},
+        { 190785, 0x176ee7f8bd29207bull},
+        { 244541, 0x8e7156ee9820341dull},
+        { 305844, 0x9447547b2b24727full},
+        { 374400, 0xdfde283baf3e8ad5ull},
+        { 449673, 0xe5f223d31bd32eb9ull},
+        { 530865, 0x0f3ae410937bc96dull},
+        { 616896, 0x5ecd64d8de81ff59ull},
+    },
+    {
+        {   1056, 0xce6020dd131c6d9dull},
+        {   3689, 0xcb528c1c746be8d4ull},
+        {   8925, 0x241ede22651554d7ull},
+        {  17748, 0x973e2ab03bff8a9dull},
+        {  31080, 0x446d95d1e6afa635ull},
+        {  49761, 0x0a40656a32c2b9fdull},
+        {  74529, 0xa0e0d5458c3a49c5ull},
+        { 106000, 0x49885b78abee444dull},
+        { 144648, 0xa57d95896495332bull},
+        { 190785, 0x90a55939d9b913f3ull},
+        { 244541, 0xf6c90b3dc20c8fbdull},
+        { 305844, 0xb45394edf22fed89ull},
+        { 374400, 0xa5ca26dbdde330b9ull},
+        { 449673, 0xdc2c3a23c53b0203ull},
+        { 530865, 0x2a809575a46c1871ull},
+        { 616896, 0x634139830485a637ull},
+    },
+    {
+        {   1056, 0xce6020dd131c6d9dull},
+        {   3689, 0xcb528c1c746be8d4ull},
+        {   8925, 0x9c3bea79c1fc628full},
+        {  17748, 0x1cda5a053a1eaed8ull},
+        {  31080, 0xb6a65042f76ad09dull},
+        {  49761, 0x6e20dc7b4479c105ull},
+        {  74529, 0xf5eb65fdb91b911dull},
+        { 106000, 0x4767f39318353fedull},
+        { 144648, 0xca82f2c5e43a002full},
+        { 190785, 0xe1c36f011e41463full},
+        { 244541, 0x5b70884aa4245fd1ull},
+        { 305844, 0x3e5213e55402d17full},
+        { 374400, 0x4aa09ec8d95b45a5ull},
+        { 449673, 0x9194ef733d1d2741ull},
+        { 530865, 0x56150bc35c3f59e5ull},
+        { 616896, 0xedc0d33722eb35d1ull},
+    },
+};
+
+static const Digest GOLDEN_64[NUM_STYLES][32] = {
+    {
+        {     14, 0x4c50188a87de1cc4ull},
+        {     56, 0x47bb5d4ac4e7203eull},
+        {    153, 0x3ade397205a7611aull},
+        {    270, 0xf530d40528e865ecull},
+        {    414, 0x5894f38f62facc86ull},
+        {    585, 0x861e794924fe18f0ull},
+        {    783, 0x8ea5860a5bd402c9ull},
+        {   1008, 0x12a9033f5b9a0424ull},
+        {   1260, 0x5d959732a368b09bull},
+        {   1539, 0xc5c6fd5ada9c8019ull},
+        {   1845, 0x5bfa3c1268091757ull},
+        {   2178, 0x066e80a71f1769ccull},
+        {   2538, 0x5407b7a4381c4b68ull},
+        {   2925, 0x3fb43d61f1f4b613ull},
+        {   3339, 0xc3e4b1aa9f2cc02aull},
+        {   3780, 0x4189cc75b243da7eull},
+        {   4248, 0xb39bc281f198ecd3ull},
+        {   4743, 0xe97d9e81857a1b67ull},
+        {   5265, 0x0bfcc5c983d6aaeeull},
+        {   5814, 0x6fd7eb13b3176973ull},
+        {   6390, 0xd8f9e29ce2723691ull},
+        {   6993, 0x97d43eec7a072f4aull},
+        {   7623, 0x483156ed89cc09fbull},
+        {   8280, 0x77f8f52007e140abull},
+        {   8964, 0xec9ada3de0cbb8b2ull},
+        {   9675, 0x95e02bf5f541a27full},
+        {  10413, 0x63ae89a008a5d8cdull},
+        {  11178, 0x1b8026a466447649ull},
+        {  11970, 0x4dab6416aba4f65aull},
+        {  12789, 0xcbbf207efb1739ebull},
+        {  13635, 0x6f0942bb9a94e5dbull},
+        {  14508, 0x1d70d6fce4b32608ull},
+    },
+    {
+        {     14, 0x4c50188a87de1cc4ull},
+        {     56, 0x47bb5d4ac4e7203eull},
+        {    153, 0xf5787af3e9572941ull},
+        {    270, 0x362f45a36169fdadull},
+        {    414, 0x37c3b03e2c8cc394ull},
+        {    585, 0x46f805196e882053ull},
+        {    783, 0x5a800bdb061a3e80ull},
+        {   1008, 0x5031ee675a7320a3ull},
+        {   1260, 0xf62663cd7f3217eeull},
+        {   1539, 0x045fb35ec1661be6ull},
+        {   1845, 0x21b2e1e81c5c007dull},
+        {   2178, 0xd4cc67433b8b9b69ull},
+        {   2538, 0x05a319948e4f1579ull},
+        {   2925, 0xc1b090b8a5bb35ddull},
+        {   3339, 0xbb4c985db3dd59a2ull},
+        {   3780, 0x6c029a6505c013aaull},
+        {   4248, 0x883198f5cbb925a9ull},
+        {   4743, 0xd1005f75f84273edull},
+        {   5265, 0x3509b935680c74a8ull},
+        {   5814, 0x041ea50bb9807a2full},
+        {   6390, 0x19bafcc6faba2e5bull},
+        {   6993, 0x645e141a10c72fc9ull},
+        {   7623, 0x823a48dcdb6b2c98ull},
+        {   8280, 0xf8ef32456b35c635ull},
+        {   8964, 0x6f1ae793e749986cull},
+        {   9675, 0x8b3a0a97799b338cull},
+        {  10413, 0xa1a689cb4262e4c2ull},
+        {  11178, 0x52dbc15698a2a0b5ull},
+        {  11970, 0xc996223d02ebc77aull},
+        {  12789, 0x7498d8434ab31019ull},
+        {  13635, 0x36154a9f78978e22ull},
+        {  14508, 0x6a3b31ed057f47ddull},
+    },
+    {
+        {     14, 0x4c50188a87de1cc4ull},
+        {     56, 0x47bb5d4ac4e7203eull},
+        {    153, 0x3ade397205a7611aull},
+        {    270, 0xf530d40528e865ecull},
+        {    414, 0x19c4a160f23f80efull},
+        {    585, 0x51334d50cbf0a786ull},
+        {    783, 0x4cd49a547dfe5d5eull},
+        {   1008, 0x06a76a4565564eacull},
+        {   1260, 0x36143942b437c654ull},
+        {   1539, 0x890911913a13d4a1ull},
+        {   1845, 0xa39e305753319f9cull},
+        {   2178, 0x23e01771eb06be93ull},
+        {   2538, 0x883c281a0409d0ecull},
+        {   2925, 0xf84298a820b8d90cull},
+        {   3339, 0x8b65cce9f42e7894ull},
+        {   3780, 0x85746f4519da309bull},
+        {   4248, 0xe8e2571ca618e6adull},
+        {   4743, 0x6ec19be8206ed286ull},
+        {   5265, 0x1398c4df028c33fcull},
+        {   5814, 0xb905450d843c1ce3ull},
+        {   6390, 0x2cb968c57589dd59ull},
+        {   6993, 0x50a00ec571bd09cfull},
+        {   7623, 0xa196eab2c3a3f305ull},
+        {   8280, 0x279fca85d6ffd2b8ull},
+        {   8964, 0xbc730e44e8a44163ull},
+        {   9675, 0x0a696f05035e1c7cull},
+        {  10413, 0x5b18faf4dbae2811ull},
+        {  11178, 0x3659296802ff6180ull},
+        {  11970, 0x9811582499f46801ull},
+        {  12789, 0x274a818c4cf49814ull},
+        {  13635, 0xfc5c4b704d8e75d6ull},
+        {  14508, 0x8ea1871e8331efa5ull},
+    },
+};
+
+static const Digest GOLDEN_128[NUM_STYLES][64] = {
+    {
+        {     14, 0x4d729c00bddbdf64ull},
+        {     56, 0x04e76c96d676c616ull},
+        {    153, 0x7cd8fc5b23d6d2d2ull},
+        {    270, 0x49da66ae93510ed4ull},
+        {    414, 0xb0afb361789fc826ull},
+        {    585, 0xbb51ad637dd88730ull},
+        {    783, 0x04e8335093d0fd19ull},
+        {   1008, 0x18fc5373ba629144ull},
+        {   1260, 0x12f0266cda943243ull},
+        {   1539, 0x59b306fff3f09af9ull},
+        {   1845, 0x764f715d023e7e17ull},
+        {   2178, 0x13a273518b6d284cull},
+        {   2538, 0x8961316a9cfb08d8ull},
+        {   2925, 0x6c90b903d41cb303ull},
+        {   3339, 0xe3520852f713fb6aull},
+        {   3780, 0x5d70be425dd0c6b6ull},
+        {   4248, 0x064ae20c027e932bull},
+        {   4743, 0x29fafd039c6f1bafull},
+        {   5265, 0x9dee2ab6e7c5aaeeull},
+        {   5814, 0xc2bdc2e1c46982b3ull},
+        {   6390, 0xb5fea33b4b758769ull},
+        {   6993, 0x8e1173bb3ba96582ull},
+        {   7623, 0x72540b242be31e03ull},
+        {   8280, 0xb065b2e5c0ab4fa7ull},
+        {   8964, 0x40f0f4f7ad0a1ac7ull},
+        {   9675, 0x7b59454df3953053ull},
+        {  10413, 0xc0daa8d28f382a88ull},
+        {  11178, 0x4a11107a0cd9be97ull},
+        {  11970, 0x97b0e56eaa625322ull},
+        {  12789, 0xad9012c0e5365812ull},
+        {  13635, 0x8828b92a33530112ull},
+        {  14508, 0xce8d2a2b463e6e34ull},
+        {  15408, 0x30a23e146e9d659cull},
+        {  16335, 0x33e6fbf30dfb38a7ull},
+        {  17289, 0xaf644728d08b5a0bull},
+        {  18270, 0x2d6fea99e6a83e59ull},
+        {  19278, 0x961460640e384edfull},
+        {  20313, 0xf9d0adc006f871b1ull},
+        {  21375, 0x2188a87ca9fd8df9ull},
+        {  22464, 0xfd7cf94d40b35e0full},
+        {  23580, 0x2eaa3aed2692ecacull},
+        {  24723, 0xd31f4756e20769bdull},
+        {  25893, 0x3850b3ab29f3679dull},
+        {  27090, 0x0347576026ebb0a9ull},
+        {  28314, 0x2bc0b40d03c1bfa6ull},
+        {  29565, 0x3146d9ef78d5f1ffull},
+        {  30843, 0xe517a39cfdb7c744ull},
+        {  32148, 0xd823a5d5c23751cfull},
+        {  33480, 0x21bc4653f98d4a66ull},
+        {  34839, 0x5cdd4eab63955c41ull},
+        {  36225, 0xa9f261bbbcce805aull},
+        {  37638, 0x2488cf1b78309161ull},
+        {  39078, 0x7d162498523537f5ull},
+        {  40545, 0x6a8453a29cfc41ccull},
+        {  42039, 0x8a53cdb69a574503ull},
+        {  43560, 0x182459b521b59e77ull},
+        {  45108, 0x76cadeb3c2ae6e77ull},
+        {  46683, 0xf8247f5268733ec0ull},
+        {  48285, 0x4d54a61622cfb883ull},
+        {  49914, 0xa6a0d0fd142926baull},
+        {  51570, 0x163f0d44f9f4d303ull},
+        {  53253, 0x0f1559f1d5746386ull},
+        {  54963, 0xe99b4bad1e5b4becull},
+        {  56700, 0x95dc6eb17e29ad5cull},
+    },
+    {
+        {     14, 0x4d729c00bddbdf64ull},
+        {     56, 0x04e76c96d676c616ull},
+        {    153, 0x99b7b4f2d6160ee1ull},
+        {    270, 0x0ea17af26d876e2dull},
+        {    414, 0x748f61620d92e5f4ull},
+        {    585, 0x568f5ec90c50fc83ull},
+        {    783, 0xd3c9885e731d2910ull},
+        {   1008, 0xd811b9007063d513ull},
+        {   1260, 0x24de596211b65f6eull},
+        {   1539, 0xa2768b2e1c10ef26ull},
+        {   1845, 0xf1cde43fcef39dbdull},
+        {   2178, 0xa528c4bbab5fa779ull},
+        {   2538, 0x490e46c141c8a2f9ull},
+        {   2925, 0x055351cfec0a0b05ull},
+        {   3339, 0xcd97df1f30ef3ffaull},
+        {   3780, 0x18f81eba8350e6baull},
+        {   4248, 0x72cd7937571c6c31ull},
+        {   4743, 0x06e468665603c3edull},
+        {   5265, 0xbe80dd3974d42b78ull},
+        {   5814, 0xd7a24dc276e4f29full},
+        {   6390, 0x6e2bbff7fdacec43ull},
+        {   6993, 0x9669e5f6a8959b41ull},
+        {   7623, 0x7e3565ec01312650ull},
+        {   8280, 0xe38ce472d4634400ull},
+        {   8964, 0x2a5a78b728aa294cull},
+        {   9675, 0x6d0f876b781b76a0ull},
+        {  10413, 0x1ca2676d74a58123ull},
+        {  11178, 0xf7733e2f58072f2aull},
+        {  11970, 0x50ae043bba0c69aaull},
+        {  12789, 0xbbfa458d212a5dacull},
+        {  13635, 0x45b63ad5383426daull},
+        {  14508, 0xf2fcad456123f8a9ull},
+        {  15408, 0x3b791daf125ee7edull},
+        {  16335, 0xac8767e82cd16097ull},
+        {  17289, 0xc9913f609a2367f5ull},
+        {  18270, 0x93bbe1c0bdcd5766ull},
+        {  19278, 0xe597db1d14b287f2ull},
+        {  20313, 0xd3d41fa3e4e6b003ull},
+        {  21375, 0x7ce9e4e283fd1507ull},
+        {  22464, 0x05fd911543c3356full},
+        {  23580, 0xde435c511b1ec8b8ull},
+        {  24723, 0x1425d4191a18a284ull},
+        {  25893, 0x356ee68f6fed6db7ull},
+        {  27090, 0x841cfe690ee604b0ull},
+        {  28314, 0x60b662d55decd7d7ull},
+        {  29565, 0xff9843daffd8a517ull},
+        {  30843, 0x4a9a551db5fc02d0ull},
+        {  32148, 0x413a94aab4c286bcull},
+        {  33480, 0x1a6f503b191c17afull},
+        {  34839, 0x78c3957d21f94727ull},
+        {  36225, 0x978df69eb1eb2328ull},
+        {  37638, 0x4ffe67a04d98aba6ull},
+        {  39078, 0xeb165fca529c0aedull},
+        {  40545, 0x5bdfeb5534fd6077ull},
+        {  42039, 0xb629907a64a65ea9ull},
+        {  43560, 0xe7676e8d57f505d3ull},
+        {  45108, 0x404bcb7cf514305cull},
+        {  46683, 0xd0171d51e7c0ef13ull},
+        {  48285, 0x80ffa8e91d016429ull},
+        {  49914, 0x423dc2df1a91419bull},
+        {  51570, 0xe14676eac2b00986ull},
+        {  53253, 0x8ab98cfd7151efccull},
+        {  54963, 0x1470881dbfc1a263ull},
+        {  56700, 0x38b102e86309813eull},
+    },
+    {
+        {     14, 0x4d729c00bddbdf64ull},
+        {     56, 0x04e76c96d676c616ull},
+        {    153, 0x7cd8fc5b23d6d2d2ull},
+        {    270, 0x49da66ae93510ed4ull},
+        {    414, 0x1074c5374016972full},
+        {    585, 0x5ac0b256d6770fe6ull},
+        {    783, 0x3f9323e8692728deull},
+        {   1008, 0x1050f59fe4ea762cull},
+        {   1260, 0xe0d2534f8678d86cull},
+        {   1539, 0x188d4ced4b636ef1ull},
+        {   1845, 0xe1b12dc0c0b0ef34ull},
+        {   2178, 0x18c9fdcc6fba7b6bull},
+        {   2538, 0xc8f07f870acc5d84ull},
+        {   2925, 0x4aa9ec8d015fdf94ull},
+        {   3339, 0x04f20b499eeb2f04ull},
+        {   3780, 0xdfb94cf30ebda4f3ull},
+        {   4248, 0x7b1e293d2197f14dull},
+        {   4743, 0x10ca318c413f03d6ull},
+        {   5265, 0x72ce5e68efc5e034ull},
+        {   5814, 0x221e27e26964b14bull},
+        {   6390, 0xe63b4b5ff36b4069ull},
+        {   6993, 0xf2662cb9c1ecb41full},
+        {   7623, 0xad51271f63a33091ull},
+        {   8280, 0xf721bd6336cfe3f0ull},
+        {   8964, 0x5f5ec4d1a3ebfb69ull},
+        {   9675, 0x5d9d2e3d40fae7fdull},
+        {  10413, 0xf82d7a45d1f60f73ull},
+        {  11178, 0x7e254833881d124aull},
+        {  11970, 0x25f534d83d07b0e6ull},
+        {  12789, 0x00093f055a01605eull},
+        {  13635, 0x856b016939471a7eull},
+        {  14508, 0x8329df984f2ff825ull},
+        {  15408, 0xb1b4822c7dd7cab9ull},
+        {  16335, 0xfb3a2d09908af11bull},
+        {  17289, 0x23d4af45e812f59bull},
+        {  18270, 0x382e7278c9321e74ull},
+        {  19278, 0x31cba14258114371ull},
+        {  20313, 0x0774a9d08f164c82ull},
+        {  21375, 0x1209b8293480c30aull},
+        {  22464, 0xe1355735c55a5019ull},
+        {  23580, 0x08a7f5c6ce24e024ull},
+        {  24723, 0x183232d618423096ull},
+        {  25893, 0xa06ae3ebe7bc1371ull},
+        {  27090, 0x2ef8bbbe7fbb9711ull},
+        {  28314, 0xab4623c4766a6c5cull},
+        {  29565, 0xbdd6d319982c2c61ull},
+        {  30843, 0xd2471c0e40fa7ff8ull},
+        {  32148, 0x1aa6240f7c315bc5ull},
+        {  33480, 0x161d3f3b52e9b571ull},
+        {  34839, 0x43adbff46eeae7acull},
+        {  36225, 0x6ef1fe716005c323ull},
+        {  37638, 0x73004992686dbdd8ull},
+        {  39078, 0x5e6f5ae962f31224ull},
+        {  40545, 0x52b4d80de4b2b409ull},
+        {  42039, 0x892b80e7bed4bf27ull},
+        {  43560, 0x6d73d9fcfce6ff0aull},
+        {  45108, 0x2803bc6045519ad3ull},
+        {  46683, 0x30ee380062cec4c2ull},
+        {  48285, 0xbafcfbb5a4e00194ull},
+        {  49914, 0x4209de1a0621920bull},
+        {  51570, 0x4ac16217ced044a9ull},
+        {  53253, 0x5daac6664ca85d88ull},
+        {  54963, 0xa7abd17baa0f6ac6ull},
+        {  56700, 0x625d17128dcbd1bdull},
+    },
+};
+
+// Resumen congelado de un ancho, estilo y longitud (l <= ancho / 2)
+inline const Digest& golden(unsigned int width, int style, unsigned int l) {
+    switch (widthIndex(width)) {
+        case 0: return GOLDEN_32[style][l - 1];
+        case 1: return GOLDEN_64[style][l - 1];
+        default: return GOLDEN_128[style][l - 1];
+    }
+}
+
+// Compara un generador contra el corpus de un ancho. Devuelve false y
+// rellena mismatch con la primera tupla distinta si no es bit-idéntico.
+template <typename Generator>
+inline bool verify(unsigned int width, Generator gen, Mismatch* mismatch = nullptr) {
+    for (int s = 0; s < NUM_STYLES; s++) {
+        Style style = static_cast<Style>(s);
+        for (unsigned int l = 1; l <= width / 2; l++) {
+            Digest d = digest(gen, width, style, l);
+            const Digest& g = golden(width, s, l);
+            if (d.count == g.count && d.hash == g.hash) continue;
+
+            // Localizar la primera diferencia con la referencia congelada
+            if (mismatch) {
+                bool found = false;
+                forEachTuple(width, l, [&](const Tuple& t) {
+                    if (found) return;
+                    Pattern expected = reference::render(style, t);
+                    Pattern actual = gen(style, t);
+                    if (expected != actual) {
+                        *mismatch = {width, style, t, expected, actual};
+                        found = true;
+                    }
+                });
+                if (!found) {
+                    // La referencia tampoco reproduce el resumen: tabla desactualizada
+                    *mismatch = {width, style, {l, 0, 0, 0, 0, 0}, {}, {}};
+                }
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+// Imprime la tabla GOLDEN de un ancho para pegarla en este archivo
+template <typename Generator>
+inline void printGolden(unsigned int width, Generator gen) {
+    std::printf("static const Digest GOLDEN_%u[NUM_STYLES][%u] = {\n", width, width / 2);
+    for (int s = 0; s < NUM_STYLES; s++) {
+        std::printf("    {\n");
+        for (unsigned int l = 1; l <= width / 2; l++) {
+            Digest d = digest(gen, width, static_cast<Style>(s), l);
+            std::printf("        {%7u, 0x%016llxull},\n", d.count, static_cast<unsigned long long>(d.hash));
+        }
+        std::printf("    },\n");
+    }
+    std::printf("};\n");
+}
+
+} // namespace corpus
@@ -0,0 +1,97 @@
+#pragma once
+
+// Motor de generación de patrones de Puya
+//
+// Generadores deterministas (Euclides, Fibonacci, Lineal) y reparto de
+// acentos, parametrizados por la longitud máxima del ciclo. Las secuencias
+// base (seq0/acc0) se producen igual que antes; el resultado final se
+// escribe en StepMask<MAX_LEN>.
+
+#include "Bjorklund.hpp"
+#include "StepMask.hpp"
+#include <vector>
+
+template <unsigned int MAX_LEN>
+struct PatternEngine {
+    typedef StepMask<MAX_LEN> Mask;
+
+    // Iterativo: mismos valores (módulo 2^32) que la versión recursiva
+    static unsigned int fib(unsigned int n) {
+        unsigned int a = 0, b = 1;
+        for (unsigned int i = 0; i < n; i++) {
+            unsigned int t = a + b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    static void euclidean(unsigned int l, unsigned int k, unsigned int a,
+                          Bjorklund& euclid, Bjorklund& euclid2,
+                          std::vector<bool>& seq0, std::vector<bool>& acc0) {
+        // Generar secuencia principal
+        euclid.reset();
+        euclid.init(l, k);
+        euclid.iter();
+        seq0 = euclid.sequence;
+
+        // Generar acentos si es necesario
+        if (a > 0) {
+            euclid2.reset();
+            euclid2.init(k, a);
+            euclid2.iter();
+            acc0 = euclid2.sequence;
+        }
+    }
+
+    static void fibonacci(unsigned int l, unsigned int k, unsigned int a,
+                          std::vector<bool>& seq0, std::vector<bool>& acc0) {
+        seq0.assign(l, false);
+        for (unsigned int i = 0; i < k; i++) {
+            seq0.at(fib(i) % l) = true;
+        }
+
+        acc0.assign(k, false);
+        for (unsigned int i = 0; i < a; i++) {
+            acc0.at(fib(i) % k) = true;
+        }
+    }
+
+    static void linear(unsigned int l, unsigned int k, unsigned int a,
+                       std::vector<bool>& seq0, std::vector<bool>& acc0) {
+        seq0.assign(l, false);
+        for (unsigned int i = 0; i < k; i++) {
+            seq0.at(l * i / k) = true;
+        }
+
+        acc0.assign(k, false);
+        for (unsigned int i = 0; i < a; i++) {
+            acc0.at(k * i / a) = true;
+        }
+    }
+
+    // Rota seq0 por r dentro de un ciclo de l + p pasos y asigna los acentos
+    // a los hits empezando en el desplazamiento s. Los pasos de relleno
+    // quedan siempre vacíos.
+    static void distributeAccents(const std::vector<bool>& seq0, const std::vector<bool>& acc0,
+                                  unsigned int l, unsigned int k, unsigned int a,
+                                  unsigned int s, unsigned int r, unsigned int p,
+                                  Mask& sequence, Mask& accents) {
+        sequence.reset();
+        accents.reset();
+
+        const unsigned int len = l + p;
+        unsigned int j = k - s;
+        unsigned int idx = r % len;
+        for (unsigned int i = 0; i < seq0.size(); i++) {
+            if (seq0[i]) {
+                sequence.set(idx);
+                if (a) {
+                    if (acc0.at(j % k)) accents.set(idx);
+                    j++;
+                }
+            }
+            if (++idx == len) idx = 0;
+        }
+    }
+};
@@ -0,0 +1,275 @@
+#pragma once
+
+// Índice inverso de patrones: ritmo escrito -> parámetros (l, k, r, p, a, s)
+//
+// Un patrón de Puya es el seq0 del estilo para (l, k), completado con p
+// silencios y rotado r pasos; los acentos de acc0 (k, a) se reparten entre
+// sus hits desde el desplazamiento s (ver PatternEngine::distributeAccents).
+// La rotación no cambia la forma del ritmo, así que el índice guarda cada
+// (l, k, p) en forma canónica (la rotación de menor valor de sus n = l + p
+// pasos) junto con la rotación que lleva a ella. Para un ritmo escrito
+// basta canonicalizarlo, buscarlo en la tabla y restar las dos rotaciones
+// para obtener r. Varias combinaciones pueden dar el mismo ritmo (en
+// Fibonacci, distintos k); se guardan todas porque k decide qué acentos
+// son posibles.
+//
+// Los acentos se buscan después, sobre cada (l, k) encontrado: a lo sumo
+// k valores de a por k desplazamientos, con máscaras de dos palabras. Ante
+// un empate gana el menor (l, k, r).
+//
+// Si el ritmo no está en el índice, find() recorre las entradas de la
+// misma longitud y devuelve la de menor distancia de Hamming (primero en
+// los hits y luego en los acentos).
+//
+// Se construye una vez por estilo y longitud máxima, en el primer uso
+// (con 128 pasos son unas 180.000 entradas). Sólo se usa desde el hilo de
+// la interfaz.
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class PatternIndex {
+public:
+    static const unsigned int MAX_STEPS = 128;
+
+    // Pasos de un ritmo, bit i = paso i
+    struct Bits {
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+
+        bool operator[](unsigned int i) const { return ((i < 64 ? lo >> i : hi >> (i - 64)) & 1) != 0; }
+
+        void set(unsigned int i) {
+            if (i < 64) lo |= uint64_t(1) << i;
+            else hi |= uint64_t(1) << (i - 64);
+        }
+
+        bool operator==(const Bits& o) const { return lo == o.lo && hi == o.hi; }
+        bool operator<(const Bits& o) const { return hi != o.hi ? hi < o.hi : lo < o.lo; }
+        Bits operator&(const Bits& o) const { Bits r; r.lo = lo & o.lo; r.hi = hi & o.hi; return r; }
+        Bits operator|(const Bits& o) const { Bits r; r.lo = lo | o.lo; r.hi = hi | o.hi; return r; }
+        Bits operator^(const Bits& o) const { Bits r; r.lo = lo ^ o.lo; r.hi = hi ^ o.hi; return r; }
+
+        unsigned int count() const { return __builtin_popcountll(lo) + __builtin_popcountll(hi); }
+
+        // Pasos 0..n-1 a 1
+        static Bits first(unsigned int n) {
+            Bits r;
+            r.lo = n >= 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+            r.hi = n >= 128 ? ~uint64_t(0) : n > 64 ? (uint64_t(1) << (n - 64)) - 1 : 0;
+            return r;
+        }
+
+        Bits up(unsigned int s) const {
+            Bits r;
+            if (s == 0) return *this;
+            if (s >= 64) {
+                r.hi = lo << (s - 64);
+            } else {
+                r.hi = (hi << s) | (lo >> (64 - s));
+                r.lo = lo << s;
+            }
+            return r;
+        }
+
+        Bits down(unsigned int s) const {
+            Bits r;
+            if (s == 0) return *this;
+            if (s >= 64) {
+                r.lo = hi >> (s - 64);
+            } else {
+                r.lo = (lo >> s) | (hi << (64 - s));
+                r.hi = hi >> s;
+            }
+            return r;
+        }
+
+        // Rota s pasos hacia índices mayores dentro de un ciclo de n pasos
+        Bits rotate(unsigned int n, unsigned int s) const {
+            s %= n;
+            if (s == 0) return *this;
+            return (up(s) | down(n - s)) & first(n);
+        }
+    };
+
+    // Estilo: seq0 para (l, k) y acc0 para (k, a), como en resetVoice
+    typedef void (*Generator)(unsigned int l, unsigned int k, unsigned int a,
+                              std::vector<bool>& seq0, std::vector<bool>& acc0);
+
+    struct Match {
+        bool found = false;
+        unsigned int l = 0, k = 0, r = 0, p = 0, a = 0, s = 0;
+        unsigned int hitDistance = 0;     // pasos con hit distinto
+        unsigned int accentDistance = 0;  // pasos con acento distinto
+
+        bool exact() const { return found && hitDistance == 0 && accentDistance == 0; }
+    };
+
+    PatternIndex(Generator generator, unsigned int maxLength)
+        : generator(generator), maxLength(maxLength < MAX_STEPS ? maxLength : MAX_STEPS) {
+        std::vector<bool> seq0, acc0;
+        for (unsigned int l = 1; l <= this->maxLength / 2; l++) {
+            for (unsigned int k = 1; k <= l; k++) {
+                Bits steps = baseSteps(l, k, seq0, acc0);
+                if (steps.count() == 0) continue;
+                for (unsigned int n = l; n <= this->maxLength; n++) {
+                    unsigned int rotation = 0;
+                    Key key = {canonical(steps, n, rotation), n};
+                    Entry entry = {static_cast<uint8_t>(l), static_cast<uint8_t>(k),
+                                   static_cast<uint8_t>(rotation)};
+                    table.insert(std::make_pair(key, entry));
+                }
+            }
+        }
+    }
+
+    size_t size() const { return table.size(); }
+
+    // Parámetros que reproducen el ritmo de n pasos (acentos sólo sobre
+    // hits) o, si no hay ninguno, los más cercanos
+    Match find(const Bits& hits, const Bits& accents, unsigned int n) const {
+        Match m;
+        if (n == 0 || n > maxLength) return m;
+        Bits mask = Bits::first(n);
+        Bits h = hits & mask;
+        Bits acc = accents & h;
+
+        unsigned int t = 0;
+        Key key = {canonical(h, n, t), n};
+        auto range = table.equal_range(key);
+        if (range.first != range.second) {
+            for (auto it = range.first; it != range.second; ++it) {
+                Match c;
+                setHits(c, it->second, n, (it->second.rotation + n - t) % n, 0);
+                matchAccents(c, acc);
+                if (!m.found || c.accentDistance < m.accentDistance
+                    || (c.accentDistance == m.accentDistance && before(it->second, c.r, m))) {
+                    m = c;
+                }
+            }
+            return m;
+        }
+
+        // Más cercano: cada entrada de n pasos en todas sus rotaciones
+        for (const auto& kv : table) {
+            if (kv.first.n != n) continue;
+            for (unsigned int u = 0; u < n; u++) {
+                unsigned int d = (kv.first.steps.rotate(n, u) ^ h).count();
+                unsigned int r = (kv.second.rotation + u) % n;
+                if (!m.found || d < m.hitDistance || (d == m.hitDistance && before(kv.second, r, m))) {
+                    setHits(m, kv.second, n, r, d);
+                }
+            }
+        }
+        if (!m.found) return m;
+        matchAccents(m, acc);
+        return m;
+    }
+
+private:
+    struct Key {
+        Bits steps;
+        unsigned int n;
+
+        bool operator==(const Key& o) const { return n == o.n && steps == o.steps; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t x = key.steps.lo ^ (key.steps.hi * 0x9E3779B97F4A7C15ull) ^ (uint64_t(key.n) << 56);
+            x ^= x >> 31;
+            x *= 0xBF58476D1CE4E5B9ull;
+            return static_cast<size_t>(x ^ (x >> 29));
+        }
+    };
+
+    // p = n - l; rotation lleva el seq0 completado a la forma canónica
+    struct Entry {
+        uint8_t l;
+        uint8_t k;
+        uint8_t rotation;
+    };
+
+    Generator generator;
+    unsigned int maxLength;
+    std::unordered_multimap<Key, Entry, KeyHash> table;
+
+    Bits baseSteps(unsigned int l, unsigned int k, std::vector<bool>& seq0, std::vector<bool>& acc0) const {
+        seq0.clear();
+        acc0.clear();
+        generator(l, k, 0, seq0, acc0);
+        Bits steps;
+        for (unsigned int i = 0; i < seq0.size() && i < l; i++) {
+            if (seq0[i]) steps.set(i);
+        }
+        return steps;
+    }
+
+    // Rotación de menor valor de los n pasos y cuánto hubo que rotar
+    static Bits canonical(const Bits& steps, unsigned int n, unsigned int& rotation) {
+        Bits best = steps;
+        rotation = 0;
+        for (unsigned int s = 1; s < n; s++) {
+            Bits x = steps.rotate(n, s);
+            if (x < best) {
+                best = x;
+                rotation = s;
+            }
+        }
+        return best;
+    }
+
+    static void setHits(Match& m, const Entry& e, unsigned int n, unsigned int r, unsigned int d) {
+        m.found = true;
+        m.l = e.l;
+        m.k = e.k;
+        m.p = n - e.l;
+        m.r = r;
+        m.hitDistance = d;
+    }
+
+    // Desempate del más cercano: menor (l, k, p, r)
+    static bool before(const Entry& e, unsigned int r, const Match& m) {
+        if (e.l != m.l) return e.l < m.l;
+        if (e.k != m.k) return e.k < m.k;
+        return r < m.r;
+    }
+
+    // Mejor (a, s) para los hits de m, como en distributeAccents: el hit
+    // i-ésimo desde r lleva acc0[(k - s + i) % k]
+    void matchAccents(Match& m, const Bits& accents) const {
+        std::vector<bool> seq0, acc0;
+        Bits steps = baseSteps(m.l, m.k, seq0, acc0);
+        unsigned int n = m.l + m.p;
+
+        unsigned int order[MAX_STEPS];
+        unsigned int hits = 0;
+        for (unsigned int i = 0; i < m.l; i++) {
+            if (steps[i]) order[hits++] = (m.r + i) % n;
+        }
+
+        m.a = 0;
+        m.s = 0;
+        m.accentDistance = accents.count();
+        for (unsigned int a = 1; a <= m.k && m.accentDistance > 0; a++) {
+            seq0.clear();
+            acc0.clear();
+            generator(m.k, m.k, a, seq0, acc0);
+            if (acc0.size() < m.k) continue;
+            for (unsigned int s = 0; s < m.k; s++) {
+                Bits x;
+                for (unsigned int i = 0; i < hits; i++) {
+                    if (acc0[(m.k - s + i) % m.k]) x.set(order[i]);
+                }
+                unsigned int d = (x ^ accents).count();
+                if (d < m.accentDistance) {
+                    m.a = a;
+                    m.s = s;
+                    m.accentDistance = d;
+                    if (d == 0) break;
+                }
+            }
+        }
+    }
+};
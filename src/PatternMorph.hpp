@@ -0,0 +1,103 @@
+#pragma once
+
+// Camino de transformación entre dos patrones
+//
+// build() precalcula la secuencia ordenada de patrones intermedios entre
+// dos extremos (máscaras de hits y acentos con su longitud de ciclo).
+// Cada nodo difiere del anterior en un solo cambio: un paso más o menos
+// de longitud, o un paso que cambia de estado (silencio, hit o acento).
+// El camino tiene la distancia de Hamming mínima y recorrer el morph sólo
+// indexa en él.
+//
+// Orden de los cambios: si el ciclo crece, primero se alarga (con
+// silencios); después cada hit que sobra se mueve al hit nuevo más
+// próximo en orden (quitar + poner), luego se corrigen los acentos y, si
+// el ciclo se acorta, al final se recorta (los pasos finales ya están
+// vacíos).
+
+#include "StepMask.hpp"
+#include <vector>
+
+template <unsigned int MAX_LEN>
+struct MorphPath {
+    typedef StepMask<MAX_LEN> Mask;
+
+    struct Node {
+        Mask sequence;
+        Mask accents;
+        unsigned int length;
+    };
+
+    std::vector<Node> nodes;
+
+    MorphPath() {
+        // Peor caso: MAX_LEN cambios de longitud, de hits y de acentos
+        nodes.reserve(3 * MAX_LEN + 1);
+    }
+
+    size_t size() const { return nodes.size(); }
+
+    // Índice del nodo para una posición x (0-1) a lo largo del camino
+    size_t index(float x) const {
+        size_t last = nodes.size() - 1;
+        size_t i = static_cast<size_t>(x * last + 0.5f);
+        return (i < last) ? i : last;
+    }
+
+    void build(const Mask& seqA, const Mask& accA, unsigned int lenA,
+               const Mask& seqB, const Mask& accB, unsigned int lenB) {
+        nodes.clear();
+        Node node;
+        node.sequence = seqA;
+        node.accents = accA & seqA;
+        node.length = lenA;
+        nodes.push_back(node);
+
+        // Alargar el ciclo con silencios
+        while (node.length < lenB) {
+            node.length++;
+            nodes.push_back(node);
+        }
+
+        // Hits que sobran y que faltan, emparejados en orden de posición
+        unsigned int removed[MAX_LEN];
+        unsigned int added[MAX_LEN];
+        unsigned int numRemoved = 0, numAdded = 0;
+        unsigned int span = (lenA > lenB) ? lenA : lenB;
+        for (unsigned int i = 0; i < span; i++) {
+            bool a = (i < lenA) && seqA[i];
+            bool b = (i < lenB) && seqB[i];
+            if (a && !b) removed[numRemoved++] = i;
+            if (b && !a) added[numAdded++] = i;
+        }
+
+        unsigned int moves = (numRemoved > numAdded) ? numRemoved : numAdded;
+        for (unsigned int m = 0; m < moves; m++) {
+            if (m < numRemoved) {
+                node.sequence.set(removed[m], false);
+                node.accents.set(removed[m], false);
+                nodes.push_back(node);
+            }
+            if (m < numAdded) {
+                node.sequence.set(added[m]);
+                node.accents.set(added[m], accB[added[m]]);
+                nodes.push_back(node);
+            }
+        }
+
+        // Acentos distintos en hits compartidos
+        for (unsigned int i = 0; i < lenB; i++) {
+            bool accent = seqB[i] && accB[i];
+            if (node.sequence[i] && node.accents[i] != accent) {
+                node.accents.set(i, accent);
+                nodes.push_back(node);
+            }
+        }
+
+        // Acortar el ciclo
+        while (node.length > lenB) {
+            node.length--;
+            nodes.push_back(node);
+        }
+    }
+};
@@ -1,20 +1,261 @@
 #include "Bjorklund.hpp"
+#include "PatternEngine.hpp"
+#include "NecklaceCatalog.hpp"
+#include "PuyaBus.hpp"
+#include "PatternMorph.hpp"
 #include "Catatumbo.hpp"
+#include "RhythmAnalysis.hpp"
+#include "PuyaStats.hpp"
+#include "PatternBank.hpp"
+#include "PatternIndex.hpp"
+#include "PuyaTrace.hpp"
 #include <array>
+#include <osdialog.h>
 
-// Número máximo de voces y longitud de secuencia
+// Número máximo de voces y longitud de secuencia. Las voces existen en
+// los tres anchos de máscara (32, 64 y 128 pasos) y el menú "Longitud
+// Máxima" elige cuál procesa el módulo (ver Puya::voicesOf): un ciclo de
+// 32 pasos usa máscaras de una palabra de 32 bits.
 static const int NUM_VOICES_MAX = 4;
-static const int MAX_SEQUENCE_LEN = 32;
+static const unsigned int MAX_SEQUENCE_LEN = 128;
+
+// Bits máximos del registro del modo Turing
+static const unsigned int TURING_BITS = 31;
+
+// Máximo de disparos por paso con ratchet
+static const int MAX_RATCHETS = 8;
+
+// Relaciones de paso p:q respecto al reloj maestro: p pasos cada q pulsos.
+// Ordenadas de más lenta a más rápida; RATIO_INPUT se mueve 1V por entrada.
+struct StepRatio {
+    int p;
+    int q;
+};
+
+static const StepRatio STEP_RATIOS[] = {
+    {1, 4}, {1, 3}, {1, 2}, {2, 3}, {3, 4}, {4, 5}, {1, 1},
+    {5, 4}, {4, 3}, {3, 2}, {2, 1}, {3, 1}, {4, 1},
+};
+static const int NUM_STEP_RATIOS = sizeof(STEP_RATIOS) / sizeof(STEP_RATIOS[0]);
+static const int UNIT_RATIO = 6;
+
+// Retraso máximo de microtiming por paso, en % del periodo de reloj
+static const int MAX_MICROTIMING = 50;
+
+// Ranuras del banco de instantáneas
+static const int NUM_SNAPSHOTS = 16;
+
+// Longitud máxima del catálogo de collares (-DPUYA_NECKLACE_MAX=..., hasta 24)
+#ifndef PUYA_NECKLACE_MAX
+#define PUYA_NECKLACE_MAX 16
+#endif
+
+static const unsigned int NECKLACE_MAX_LEN = PUYA_NECKLACE_MAX;
+static_assert(NECKLACE_MAX_LEN <= MAX_SEQUENCE_LEN / 2,
+              "PUYA_NECKLACE_MAX no puede superar la mitad de MAX_SEQUENCE_LEN");
+
+typedef NecklaceCatalog<NECKLACE_MAX_LEN> Necklaces;
+
+// Catálogo compartido por todas las instancias, generado en el primer uso
+static const Necklaces& necklaces() {
+    static const Necklaces catalog;
+    return catalog;
+}
+
+// Nivel de compuerta con bordes band-limited (PolyBLEP) para el modo audio.
+// Los saltos ocurren entre muestras; la salida se retrasa una muestra para
+// poder corregir también la muestra anterior a cada salto.
+struct BlepGate {
+    float level = 0.0f;     // valor ingenuo actual
+    float previous = 0.0f;  // muestra anterior, aún sin emitir
+    float pending = 0.0f;   // corrección de la muestra actual
+
+    // Salta a target; el salto ocurrió hace delta muestras (0 <= delta < 1)
+    void setLevel(float target, float delta) {
+        float h = target - level;
+        if (h == 0.0f) return;
+        float after = 1.0f - delta;
+        previous += 0.5f * h * delta * delta;
+        pending -= 0.5f * h * after * after;
+        level = target;
+    }
+
+    float process() {
+        float out = previous;
+        previous = level + pending;
+        pending = 0.0f;
+        return out;
+    }
+
+    void reset() {
+        level = previous = pending = 0.0f;
+    }
+};
 
 // Declaración anticipada de Puya para permitir su referencia en Voice
 struct Puya;
 
-struct Voice {
-    // Estado de la secuencia de patrones
+// Parte de la voz que no depende del ancho de las máscaras: ajustes,
+// parámetros, relojes y disparos. VoiceT<N> le añade el patrón en máscaras
+// de N pasos; al cambiar la longitud máxima esta parte pasa tal cual a la
+// voz del nuevo ancho (ver VoiceT::assign).
+struct VoiceBase {
+    // Secuencias base del estilo (ver Puya::resetVoice)
     std::vector<bool> seq0;
     std::vector<bool> acc0;
-    std::array<bool, MAX_SEQUENCE_LEN> sequence;
-    std::array<bool, MAX_SEQUENCE_LEN> accents;
+
+    // Probabilidad por voz (las máscaras del sorteo están en VoiceT)
+    float hitProbability = 1.0f;
+    float accentProbability = 1.0f;
+    bool accentWeighted = false;  // los pasos acentuados caen con la mitad de probabilidad
+
+    // Periodo de reloj medido en muestras (0 = aún sin medir)
+    uint32_t clockSamples = 0;
+    uint32_t clockPeriod = 0;
+
+    // Ratchets: disparos extra equiespaciados dentro del paso
+    int ratchets = 1;                 // 1 = sin ratchet, hasta MAX_RATCHETS
+    bool ratchetAccentsOnly = false;  // sólo en pasos acentuados
+    int ratchetRemaining = 0;
+    uint32_t ratchetInterval = 0;
+    uint32_t ratchetCountdown = 0;
+    bool ratchetAccent = false;
+
+    // Duración de compuertas como fracción del periodo medido (0 = según
+    // el modo: disparo corto o paso completo). Se cuenta en muestras.
+    float gateLength = 0.0f;      // manual (0-1), se suma a GATE_LENGTH_INPUT
+    float accentLength = 0.0f;    // manual (0-1), se suma a ACCENT_LENGTH_INPUT
+    uint32_t gateCountdown = 0;
+    uint32_t accentCountdown = 0;
+
+    // Swing y microtiming: el disparo del paso se retrasa una cuenta atrás
+    // en muestras sobre el periodo medido (ver Puya::stepDelay)
+    float swing = 0.0f;                    // 0-1 = 0-50% del periodo en los pasos pares
+    bool microtimingOn = false;
+    uint8_t microtiming[MAX_SEQUENCE_LEN] = {};  // retraso por paso, 0-MAX_MICROTIMING %
+    float humanizeAmount = 0.2f;           // máximo del sorteo del menú (0-1)
+    uint32_t delayCountdown = 0;
+    unsigned int delayedStep = 0;
+
+    // Relación de paso con el reloj maestro. El paso j de cada grupo de q
+    // pulsos cae j*q/p pulsos después del primero; la posición se calcula
+    // con enteros desde el número de pulso (no se acumula error) y el grupo
+    // vuelve a empezar en el tiempo fuerte cada q pulsos.
+    int ratio = UNIT_RATIO;       // índice en STEP_RATIOS (menú), se suma a RATIO_INPUT
+    int ratioP = 1;               // relación efectiva del grupo en curso
+    int ratioQ = 1;
+    int ratioBeat = -1;           // pulso dentro del grupo (-1 = tras un reset)
+    int ratioStep = 0;            // próximo paso del pulso en curso
+    int ratioEnd = 0;             // primer paso del pulso siguiente
+    uint32_t ratioCountdown = 0;
+    uint32_t beatSamples = 0;     // muestras desde el último pulso maestro
+    uint32_t beatPeriod = 0;
+
+    // Fuente de reloj: maestro (CLK_INPUT) o hits/acentos de otra voz
+    enum ClockSource {
+        CLOCK_MASTER,
+        CLOCK_HITS,
+        CLOCK_ACCENTS
+    };
+    ClockSource clockSource = CLOCK_MASTER;
+    int clockVoice = 0;
+
+    // Parámetros del patrón en el orden de positions y randomDraw
+    enum PatternParam { POS_K, POS_L, POS_R, POS_P, POS_A, POS_S, NUM_POSITIONS };
+
+    // Posiciones normalizadas (perilla + CV, 0-1) que definen el patrón de
+    // la voz; las aleatoriedades se mezclan sobre ellas sin perderlas
+    float positions[NUM_POSITIONS] = {};
+    bool positionsValid = false;
+
+    // RND_INPUT: muestreo y retención en flancos de reloj o al inicio del
+    // ciclo, con un generador propio por voz (reproducible por semilla)
+    enum RandomSync {
+        RANDOM_ON_STEP,
+        RANDOM_ON_CYCLE
+    };
+    RandomSync randomSync = RANDOM_ON_CYCLE;
+    uint64_t randomSeed = 0;
+    random::Xoroshiro128Plus rng;
+    float randomAmount = 0.0f;              // profundidad retenida (0 = sin aleatoriedad)
+    float randomDraw[NUM_POSITIONS] = {};   // sorteo retenido
+
+    void seedRandom(uint64_t seed) {
+        randomSeed = seed;
+        rng.seed(seed, seed ^ 0x9e3779b97f4a7c15ull);
+    }
+
+    // Un sorteo nuevo para todos los parámetros de una vez
+    void drawRandom() {
+        for (int i = 0; i < NUM_POSITIONS; i++) {
+            randomDraw[i] = (rng() >> 40) * (1.0f / 16777216.0f);
+        }
+    }
+
+    // Modo catálogo: el patrón base es el collar necklaceId
+    bool catalog = false;
+    uint32_t necklaceId = 0;
+
+    // Modo banco: el patrón es una entrada del banco de patrones externo,
+    // elegida con K y PATTERN_INPUT y cargada al inicio del ciclo
+    bool patternBank = false;
+    int32_t bankWanted = -1;        // entrada pedida (-1 = banco vacío)
+    int32_t bankEntry = -1;         // entrada cargada en el patrón
+    uint32_t bankGeneration = 0;    // banco al que se refiere bankEntry
+
+    // Patrón literal (nodo del morph, entrada del banco): los parámetros sólo
+    // lo describen y resetVoice no lo regenera desde ellos. Se apaga cuando
+    // los parámetros vuelven a mandar (perillas, catálogo, salir del modo).
+    bool literal = false;
+
+    // Morph: transición entre dos extremos a lo largo de un camino precalculado
+    bool morphing = false;
+    float morphAmount = 0.0f;   // posición manual (0-1), se suma a MORPH_INPUT
+    bool morphDirty = true;     // extremos cambiados: recalcular el camino
+    int morphNode = -1;         // nodo aplicado (-1 = ninguno)
+
+    // Mutación al final de cada ciclo (ver mutate)
+    bool mutating = false;
+    float mutationAmount = 0.1f;    // probabilidad manual (0-1), se suma a MUTATE_INPUT
+    bool mutationKeepHits = false;
+    bool mutationLocked = false;    // congela el patrón y lo guarda con el patch
+
+    // Instantánea pendiente de aplicar al inicio del próximo ciclo (-1 = ninguna)
+    int pendingSnapshot = -1;
+    int snapshotSlot = -1;  // última ranura pedida por CV
+
+    // Sincronización en cola: el próximo paso de la voz será el 0
+    bool resyncPending = false;
+
+    // Análisis del patrón (0-1), recalculado sólo al cambiar las máscaras
+    bool analysisDirty = true;
+    float density = 0.0f;
+    float evenness = 0.0f;
+    float syncopation = 0.0f;
+    uint32_t cycleCount = 0;  // ciclos completos desde el último reset
+
+    // Eventos emitidos en la muestra actual (para voces en cascada y
+    // salidas retrasadas). stepEvent: la voz tocó un paso en esta muestra.
+    bool stepEvent = false;
+    bool hitEvent = false;
+    bool accentEvent = false;
+
+    // Paso de la rejilla en la muestra actual, antes de swing y microtiming
+    // (salidas compuestas): gridEvent = la voz avanzó, gridHit = su hit
+    bool gridEvent = false;
+    bool gridHit = false;
+
+    // Estado de salida de la muestra actual (luces)
+    bool gateHigh = false;
+    bool accentHigh = false;
+
+    // Modo audio: posición fraccional del último flanco de reloj (muestras
+    // transcurridas desde el cruce) y compuertas band-limited
+    float lastClockIn = 0.0f;
+    float edgeDelta = 0.0f;
+    float audioFall = 0.0f;
+    BlepGate audioGate;
+    BlepGate audioAccent;
 
     // Parámetros con valores por defecto
     unsigned int par_k = 4;  // relleno
@@ -48,13 +289,26 @@ struct Voice {
     Bjorklund euclid;
     Bjorklund euclid2;
 
-    // Reinicia todos los estados de la voz a valores iniciales
+    // Estados precalculados válidos (ver VoiceT::mutated, morphA y morphB)
+    bool mutatedValid = false;
+    bool morphAValid = false;
+    bool morphBValid = false;
+
+    bool canMorph() const { return morphAValid && morphBValid; }
+
+    // Reinicia los estados de la voz a valores iniciales (sin las máscaras)
     void reset() {
         // Reinicia contadores y banderas
         currentStep = 0;
+        cycleCount = 0;
         turing = 0;
         gateOn = false;
         accOn = false;
+        gateCountdown = 0;
+        accentCountdown = 0;
+        delayCountdown = 0;
+        ratioBeat = -1;
+        ratioStep = ratioEnd = 0;
         calculate = true;
     
         // Reinicia generadores de patrones
@@ -68,11 +322,356 @@ struct Voice {
         gatePulse.reset();
         accentPulse.reset();
 
-        // Limpia y reinicia todas las secuencias
+        // Limpia las secuencias base
         seq0.clear();
         acc0.clear();
-        std::fill(sequence.begin(), sequence.end(), false);
-        std::fill(accents.begin(), accents.end(), false);
+        ratchetRemaining = 0;
+        audioFall = 0.0f;
+        audioGate.reset();
+        audioAccent.reset();
+
+        // El patrón literal se borró: el morph vuelve a aplicar su nodo
+        literal = false;
+        morphNode = -1;
+    }
+
+    // Vuelve al inicio sin tocar el patrón: el próximo paso es el 0
+    void rewind() {
+        currentStep = par_l + par_p;
+        cycleCount = UINT32_MAX;  // el primer paso abre el ciclo 0
+        resyncPending = false;
+        ratioBeat = -1;
+        ratioStep = ratioEnd = 0;
+        ratchetRemaining = 0;
+        delayCountdown = 0;
+    }
+
+    // Retrasos de n pasos hasta el último distinto de 0 (nullptr si no hay)
+    static json_t* microtimingToJson(const uint8_t* offsets, unsigned int n) {
+        while (n > 0 && offsets[n - 1] == 0) n--;
+        if (n == 0) return nullptr;
+        json_t* offsetsJ = json_array();
+        for (unsigned int i = 0; i < n; i++) {
+            json_array_append_new(offsetsJ, json_integer(offsets[i]));
+        }
+        return offsetsJ;
+    }
+
+    static void microtimingFromJson(json_t* offsetsJ, uint8_t* offsets, unsigned int n) {
+        for (unsigned int i = 0; i < n; i++) {
+            json_t* offsetJ = offsetsJ ? json_array_get(offsetsJ, i) : nullptr;
+            offsets[i] = offsetJ ? clamp(static_cast<int>(json_integer_value(offsetJ)), 0, MAX_MICROTIMING) : 0;
+        }
+    }
+
+    // Acota los parámetros cargados a un ciclo de maxLength pasos
+    void clampParameters(unsigned int maxLength) {
+        // Un patrón literal que ya no cabe se regenera desde los parámetros
+        if (par_l + par_p > maxLength) literal = false;
+
+        par_l = std::max(1u, std::min(par_l, maxLength / 2));
+        par_p = std::min(par_p, maxLength - par_l);
+        par_r = std::min(par_r, par_l + par_p - 1);
+        par_k = std::max(1u, std::min(par_k, par_l));
+        par_a = std::min(par_a, par_k);
+        par_s = par_a ? std::min(par_s, par_k - 1) : 0;
+
+        // En modo catálogo la longitud es la del collar
+        if (catalog) {
+            par_l = std::min(par_l, NECKLACE_MAX_LEN);
+            if (necklaceId >= necklaces().size() || necklaces().length(necklaceId) != par_l) {
+                necklaceId = necklaces().id(par_l, 0);
+            }
+        }
+    }
+};
+
+template <unsigned int MAX_LEN>
+struct VoiceT : VoiceBase {
+    typedef PatternEngine<MAX_LEN> Engine;
+    static const unsigned int WIDTH = MAX_LEN;
+
+    // Patrón calculado
+    typename Engine::Mask sequence;
+    typename Engine::Mask accents;
+
+    // Probabilidad por voz: máscaras de sorteo del ciclo en curso
+    typename Engine::Mask hitGate;
+    typename Engine::Mask accentGate;
+
+    // Camino del morph entre morphA y morphB
+    MorphPath<MAX_LEN> morphPath;
+
+    // Reinicia todos los estados de la voz a valores iniciales
+    void reset() {
+        VoiceBase::reset();
+        sequence.reset();
+        accents.reset();
+        hitGate.fill();
+        accentGate.fill();
+    }
+
+    // Patrón ya calculado y parámetros que lo producen. Restaurarlo sólo
+    // copia palabras: no se vuelve a generar nada.
+    struct State {
+        typename Engine::Mask sequence;
+        typename Engine::Mask accents;
+        unsigned int par_k = 1, par_l = 1, par_r = 0, par_p = 0, par_s = 0, par_a = 0;
+        bool catalog = false;
+        bool literal = false;
+        uint32_t necklaceId = 0;
+        uint8_t microtiming[MAX_LEN] = {};
+
+        json_t* toJson() const {
+            json_t* stateJ = json_object();
+            json_object_set_new(stateJ, "par_k", json_integer(par_k));
+            json_object_set_new(stateJ, "par_l", json_integer(par_l));
+            json_object_set_new(stateJ, "par_r", json_integer(par_r));
+            json_object_set_new(stateJ, "par_p", json_integer(par_p));
+            json_object_set_new(stateJ, "par_s", json_integer(par_s));
+            json_object_set_new(stateJ, "par_a", json_integer(par_a));
+            json_object_set_new(stateJ, "catalog", json_boolean(catalog));
+            json_object_set_new(stateJ, "literal", json_boolean(literal));
+            json_object_set_new(stateJ, "necklaceId", json_integer(necklaceId));
+            json_object_set_new(stateJ, "sequence", maskToJson(sequence));
+            json_object_set_new(stateJ, "accents", maskToJson(accents));
+            json_t* microtimingJ = VoiceBase::microtimingToJson(microtiming, MAX_LEN);
+            if (microtimingJ) json_object_set_new(stateJ, "microtiming", microtimingJ);
+            return stateJ;
+        }
+
+        // Devuelve false si falta el patrón, no cabe en maxLength pasos o los
+        // parámetros no son una tupla válida (k <= l, a <= k)
+        bool fromJson(json_t* stateJ, unsigned int maxLength) {
+            if (!stateJ) return false;
+            json_t* sequenceJ = json_object_get(stateJ, "sequence");
+            json_t* accentsJ = json_object_get(stateJ, "accents");
+            if (!sequenceJ || !accentsJ) return false;
+
+            par_k = json_integer_value(json_object_get(stateJ, "par_k"));
+            par_l = json_integer_value(json_object_get(stateJ, "par_l"));
+            par_r = json_integer_value(json_object_get(stateJ, "par_r"));
+            par_p = json_integer_value(json_object_get(stateJ, "par_p"));
+            par_s = json_integer_value(json_object_get(stateJ, "par_s"));
+            par_a = json_integer_value(json_object_get(stateJ, "par_a"));
+            catalog = json_boolean_value(json_object_get(stateJ, "catalog"));
+            literal = json_boolean_value(json_object_get(stateJ, "literal"));
+            necklaceId = json_integer_value(json_object_get(stateJ, "necklaceId"));
+            maskFromJson(sequenceJ, sequence);
+            maskFromJson(accentsJ, accents);
+            VoiceBase::microtimingFromJson(json_object_get(stateJ, "microtiming"), microtiming, MAX_LEN);
+
+            return par_l >= 1 && par_k >= 1 && par_k <= par_l && par_a <= par_k
+                && par_l + par_p <= maxLength && par_r < par_l + par_p
+                && (!catalog || necklaceId < necklaces().size());
+        }
+
+        // Palabras de la máscara como cadenas hexadecimales
+        static json_t* maskToJson(const typename Engine::Mask& mask) {
+            json_t* wordsJ = json_array();
+            for (unsigned int i = 0; i < Engine::Mask::NUM_WORDS; i++) {
+                json_array_append_new(wordsJ, json_string(
+                    string::f("%016llx", static_cast<unsigned long long>(mask.word(i))).c_str()));
+            }
+            return wordsJ;
+        }
+
+
+        static void maskFromJson(json_t* wordsJ, typename Engine::Mask& mask) {
+            typedef typename Engine::Mask::word_t word_t;
+            mask.reset();
+            size_t count = std::min(static_cast<size_t>(json_array_size(wordsJ)),
+                                    static_cast<size_t>(Engine::Mask::NUM_WORDS));
+            for (size_t i = 0; i < count; i++) {
+                const char* word = json_string_value(json_array_get(wordsJ, i));
+                if (word) mask.setWord(i, static_cast<word_t>(std::strtoull(word, nullptr, 16)));
+            }
+        }
+
+        // Estado de otro ancho: los pasos que no caben se pierden (ver fits)
+        template <unsigned int FROM>
+        void assign(const typename VoiceT<FROM>::State& from) {
+            sequence = resizeMask<MAX_LEN>(from.sequence);
+            accents = resizeMask<MAX_LEN>(from.accents);
+            par_k = from.par_k;
+            par_l = from.par_l;
+            par_r = from.par_r;
+            par_p = from.par_p;
+            par_s = from.par_s;
+            par_a = from.par_a;
+            catalog = from.catalog;
+            literal = from.literal;
+            necklaceId = from.necklaceId;
+            std::fill(microtiming, microtiming + MAX_LEN, 0);
+            std::copy(from.microtiming, from.microtiming + std::min(MAX_LEN, FROM), microtiming);
+        }
+
+        bool fits(unsigned int maxLength) const {
+            return par_l + par_p <= maxLength;
+        }
+    };
+
+    void capture(State& state) const {
+        state.sequence = sequence;
+        state.accents = accents;
+        state.par_k = par_k;
+        state.par_l = par_l;
+        state.par_r = par_r;
+        state.par_p = par_p;
+        state.par_s = par_s;
+        state.par_a = par_a;
+        state.catalog = catalog;
+        state.literal = literal;
+        state.necklaceId = necklaceId;
+        std::copy(microtiming, microtiming + MAX_LEN, state.microtiming);
+    }
+
+    // Las secuencias base (seq0/acc0) quedan desfasadas; sólo se usan al
+    // regenerar, que las recalcula desde los parámetros restaurados
+    void restore(const State& state) {
+        sequence = state.sequence;
+        accents = state.accents;
+        par_k = state.par_k;
+        par_l = state.par_l;
+        par_r = state.par_r;
+        par_p = state.par_p;
+        par_s = state.par_s;
+        par_a = state.par_a;
+        catalog = state.catalog;
+        literal = state.literal;
+        necklaceId = state.necklaceId;
+        std::copy(state.microtiming, state.microtiming + MAX_LEN, microtiming);
+        std::fill(microtiming + MAX_LEN, microtiming + MAX_SEQUENCE_LEN, 0);
+        par_k_last = par_k;
+        par_l_last = par_l;
+        par_a_last = par_a;
+        par_last = par_k + par_l + par_r + par_p + par_s + par_a;
+        calculate = false;
+        analysisDirty = true;
+        positionsValid = false;
+    }
+
+    // Patrón mutado bloqueado, cargado del patch
+    State mutated;
+
+    // Mutación estilo Turing Machine: cada paso del ciclo cambia con
+    // probabilidad p y, también con probabilidad p, el patrón rota un paso
+    // e intercambia dos pasos vecinos. keepHits empareja altas y bajas para
+    // conservar la cantidad de hits. Los acentos siguen a sus hits.
+    template <typename RNG>
+    void mutate(float p, unsigned int length, bool keepHits, RNG rng) {
+        typedef typename Engine::Mask Mask;
+        unsigned int p8 = static_cast<unsigned int>(p * 256.0f);
+        if (p8 == 0 || length < 2) return;
+
+        Mask flips = Mask::bernoulli(p8, rng) & Mask::firstSteps(length);
+        Mask off = flips & sequence;
+        Mask on = flips & ~sequence;
+        if (keepHits) {
+            unsigned int numOff = off.count();
+            unsigned int numOn = on.count();
+            for (; numOff > numOn; numOff--) off.clearLowest();
+            for (; numOn > numOff; numOn--) on.clearLowest();
+        }
+        sequence = (sequence & ~off) | on;
+        accents = accents & sequence;
+
+        uint64_t r = rng();
+        if ((r & 0xff) < p8) {
+            bool up = (r >> 8) & 1;
+            sequence = rotateSteps(sequence, length, up);
+            accents = rotateSteps(accents, length, up);
+        }
+        if (((r >> 16) & 0xff) < p8) {
+            unsigned int i = static_cast<unsigned int>((r >> 32) % length);
+            unsigned int j = (i + 1 == length) ? 0 : i + 1;
+            bool hit = sequence[i], accent = accents[i];
+            sequence.set(i, sequence[j]);
+            accents.set(i, accents[j]);
+            sequence.set(j, hit);
+            accents.set(j, accent);
+        }
+        analysisDirty = true;
+    }
+
+    // Rota un paso dentro de un ciclo de length pasos
+    static typename Engine::Mask rotateSteps(const typename Engine::Mask& mask, unsigned int length, bool up) {
+        typename Engine::Mask r;
+        if (up) {
+            r = mask.shiftUp() & Engine::Mask::firstSteps(length);
+            r.set(0, mask[length - 1]);
+        } else {
+            r = mask.shiftDown();
+            r.set(length - 1, mask[0]);
+        }
+        return r;
+    }
+
+    // Extremos del morph (se fijan desde el patrón actual)
+    State morphA;
+    State morphB;
+
+    // Aplica un nodo del camino como patrón literal
+    void applyMorphNode(const typename MorphPath<MAX_LEN>::Node& node, unsigned int maxLength) {
+        sequence = node.sequence;
+        accents = node.accents;
+        setLiteral(node.length, maxLength);
+        positionsValid = false;
+    }
+
+    // Marca el patrón actual (sequence/accents, de length pasos) como
+    // literal. Los parámetros lo describen para el resto del módulo
+    // (paso, display, acentos) con una tupla válida: l = length sin relleno
+    // si cabe, k y a acotados a l y k.
+    void setLiteral(unsigned int length, unsigned int maxLength) {
+        par_l = std::max(1u, std::min(length, maxLength / 2));
+        par_p = length - par_l;
+        par_k = std::max(1u, std::min(sequence.count(), par_l));
+        par_a = std::min(accents.count(), par_k);
+        par_r = 0;
+        par_s = 0;
+        par_k_last = par_k;
+        par_l_last = par_l;
+        par_a_last = par_a;
+        par_last = par_k + par_l + par_r + par_p + par_s + par_a;
+        literal = true;
+        calculate = false;
+        analysisDirty = true;
+    }
+
+    void analyze() {
+        unsigned int n = par_l + par_p;
+        density = rhythm::density(sequence, n);
+        evenness = rhythm::evenness(sequence, n);
+        syncopation = rhythm::syncopation(sequence, n);
+        analysisDirty = false;
+    }
+
+    // Sortea de una vez los hits y acentos de todo el ciclo. depth (0-1)
+    // reduce ambas probabilidades adicionalmente (RND_INPUT).
+    template <typename RNG>
+    void rollProbabilities(float depth, RNG rng) {
+        typedef typename Engine::Mask Mask;
+        float hitP = clamp(hitProbability - depth, 0.0f, 1.0f);
+        float accentP = clamp(accentProbability - depth, 0.0f, 1.0f);
+
+        hitGate = Mask::bernoulli(static_cast<unsigned int>(hitP * 256.0f), rng);
+        if (accentWeighted) {
+            // Pasos acentuados: probabilidad a medio camino hacia 1
+            float weightedP = 0.5f * (1.0f + hitP);
+            Mask weighted = Mask::bernoulli(static_cast<unsigned int>(weightedP * 256.0f), rng);
+            hitGate = (weighted & accents) | (hitGate & ~accents);
+        }
+        accentGate = Mask::bernoulli(static_cast<unsigned int>(accentP * 256.0f), rng);
+    }
+
+    // Hit efectivo del paso tras aplicar la probabilidad
+    bool hitAt(unsigned int step) const {
+        return sequence[step] && hitGate[step];
+    }
+
+    bool accentAt(unsigned int step) const {
+        return par_a && accents[step] && hitGate[step] && accentGate[step];
     }
 
     // Guarda estado de la voz en JSON
@@ -87,6 +686,61 @@ struct Voice {
         json_object_set_new(voiceJ, "par_p", json_integer(par_p));
         json_object_set_new(voiceJ, "par_s", json_integer(par_s));
         json_object_set_new(voiceJ, "par_a", json_integer(par_a));
+
+        // Capa de probabilidad
+        json_object_set_new(voiceJ, "hitProbability", json_real(hitProbability));
+        json_object_set_new(voiceJ, "accentProbability", json_real(accentProbability));
+        json_object_set_new(voiceJ, "accentWeighted", json_boolean(accentWeighted));
+
+        // Ratchets
+        json_object_set_new(voiceJ, "ratchets", json_integer(ratchets));
+        json_object_set_new(voiceJ, "ratchetAccentsOnly", json_boolean(ratchetAccentsOnly));
+
+        // Duración de compuertas
+        json_object_set_new(voiceJ, "gateLength", json_real(gateLength));
+        json_object_set_new(voiceJ, "accentLength", json_real(accentLength));
+
+        // Swing y microtiming
+        json_object_set_new(voiceJ, "swing", json_real(swing));
+        json_object_set_new(voiceJ, "microtimingOn", json_boolean(microtimingOn));
+        json_object_set_new(voiceJ, "humanizeAmount", json_real(humanizeAmount));
+        json_t* microtimingJ = microtimingToJson(microtiming, MAX_SEQUENCE_LEN);
+        if (microtimingJ) json_object_set_new(voiceJ, "microtiming", microtimingJ);
+
+        // Relación de paso
+        json_object_set_new(voiceJ, "ratio", json_integer(ratio));
+
+        // Enrutamiento de reloj
+        json_object_set_new(voiceJ, "clockSource", json_integer(clockSource));
+        json_object_set_new(voiceJ, "clockVoice", json_integer(clockVoice));
+
+        // Catálogo de collares
+        json_object_set_new(voiceJ, "catalog", json_boolean(catalog));
+        json_object_set_new(voiceJ, "necklaceId", json_integer(necklaceId));
+
+        // Banco de patrones
+        json_object_set_new(voiceJ, "patternBank", json_boolean(patternBank));
+
+        // Aleatoriedad por RND_INPUT
+        json_object_set_new(voiceJ, "randomSync", json_integer(randomSync));
+        json_object_set_new(voiceJ, "randomSeed", json_integer(static_cast<json_int_t>(randomSeed)));
+
+        // Morph
+        json_object_set_new(voiceJ, "morphing", json_boolean(morphing));
+        json_object_set_new(voiceJ, "morphAmount", json_real(morphAmount));
+        if (morphAValid) json_object_set_new(voiceJ, "morphA", morphA.toJson());
+        if (morphBValid) json_object_set_new(voiceJ, "morphB", morphB.toJson());
+
+        // Mutación; el patrón sólo se guarda bloqueado
+        json_object_set_new(voiceJ, "mutating", json_boolean(mutating));
+        json_object_set_new(voiceJ, "mutationAmount", json_real(mutationAmount));
+        json_object_set_new(voiceJ, "mutationKeepHits", json_boolean(mutationKeepHits));
+        json_object_set_new(voiceJ, "mutationLocked", json_boolean(mutationLocked));
+        if (mutationLocked) {
+            State state;
+            capture(state);
+            json_object_set_new(voiceJ, "mutated", state.toJson());
+        }
         
         return voiceJ;
     }
@@ -114,6 +768,181 @@ struct Voice {
         
         json_t* par_aJ = json_object_get(voiceJ, "par_a");
         if (par_aJ) par_a = json_integer_value(par_aJ);
+
+        json_t* hitProbabilityJ = json_object_get(voiceJ, "hitProbability");
+        if (hitProbabilityJ) hitProbability = clamp(static_cast<float>(json_number_value(hitProbabilityJ)), 0.0f, 1.0f);
+
+        json_t* accentProbabilityJ = json_object_get(voiceJ, "accentProbability");
+        if (accentProbabilityJ) accentProbability = clamp(static_cast<float>(json_number_value(accentProbabilityJ)), 0.0f, 1.0f);
+
+        json_t* accentWeightedJ = json_object_get(voiceJ, "accentWeighted");
+        if (accentWeightedJ) accentWeighted = json_boolean_value(accentWeightedJ);
+
+        json_t* ratchetsJ = json_object_get(voiceJ, "ratchets");
+        if (ratchetsJ) ratchets = clamp(static_cast<int>(json_integer_value(ratchetsJ)), 1, MAX_RATCHETS);
+
+        json_t* ratchetAccentsOnlyJ = json_object_get(voiceJ, "ratchetAccentsOnly");
+        if (ratchetAccentsOnlyJ) ratchetAccentsOnly = json_boolean_value(ratchetAccentsOnlyJ);
+
+        json_t* gateLengthJ = json_object_get(voiceJ, "gateLength");
+        if (gateLengthJ) gateLength = clamp(static_cast<float>(json_number_value(gateLengthJ)), 0.0f, 1.0f);
+
+        json_t* accentLengthJ = json_object_get(voiceJ, "accentLength");
+        if (accentLengthJ) accentLength = clamp(static_cast<float>(json_number_value(accentLengthJ)), 0.0f, 1.0f);
+
+        json_t* swingJ = json_object_get(voiceJ, "swing");
+        if (swingJ) swing = clamp(static_cast<float>(json_number_value(swingJ)), 0.0f, 1.0f);
+
+        microtimingOn = json_boolean_value(json_object_get(voiceJ, "microtimingOn"));
+        json_t* humanizeAmountJ = json_object_get(voiceJ, "humanizeAmount");
+        if (humanizeAmountJ) humanizeAmount = clamp(static_cast<float>(json_number_value(humanizeAmountJ)), 0.0f, 1.0f);
+        microtimingFromJson(json_object_get(voiceJ, "microtiming"), microtiming, MAX_SEQUENCE_LEN);
+
+        json_t* ratioJ = json_object_get(voiceJ, "ratio");
+        if (ratioJ) ratio = clamp(static_cast<int>(json_integer_value(ratioJ)), 0, NUM_STEP_RATIOS - 1);
+
+        json_t* clockSourceJ = json_object_get(voiceJ, "clockSource");
+        if (clockSourceJ) clockSource = static_cast<ClockSource>(clamp(static_cast<int>(json_integer_value(clockSourceJ)), 0, 2));
+
+        json_t* clockVoiceJ = json_object_get(voiceJ, "clockVoice");
+        if (clockVoiceJ) clockVoice = clamp(static_cast<int>(json_integer_value(clockVoiceJ)), 0, NUM_VOICES_MAX - 1);
+
+        json_t* catalogJ = json_object_get(voiceJ, "catalog");
+        if (catalogJ) catalog = json_boolean_value(catalogJ);
+
+        patternBank = json_boolean_value(json_object_get(voiceJ, "patternBank"));
+        bankEntry = -1;
+
+        json_t* necklaceIdJ = json_object_get(voiceJ, "necklaceId");
+        if (necklaceIdJ) necklaceId = json_integer_value(necklaceIdJ);
+
+        json_t* randomSyncJ = json_object_get(voiceJ, "randomSync");
+        if (randomSyncJ) randomSync = static_cast<RandomSync>(clamp(static_cast<int>(json_integer_value(randomSyncJ)), 0, 1));
+
+        json_t* randomSeedJ = json_object_get(voiceJ, "randomSeed");
+        if (randomSeedJ) seedRandom(static_cast<uint64_t>(json_integer_value(randomSeedJ)));
+        randomAmount = 0.0f;
+        positionsValid = false;
+        literal = false;  // el patrón no se guarda: sale de los parámetros
+    }
+
+    // Estados precalculados (extremos del morph y patrón mutado bloqueado):
+    // se validan contra maxLength como las instantáneas
+    void statesFromJson(json_t* voiceJ, unsigned int maxLength) {
+        if (!voiceJ) return;
+
+        mutating = json_boolean_value(json_object_get(voiceJ, "mutating"));
+        json_t* mutationAmountJ = json_object_get(voiceJ, "mutationAmount");
+        if (mutationAmountJ) mutationAmount = clamp(static_cast<float>(json_number_value(mutationAmountJ)), 0.0f, 1.0f);
+        mutationKeepHits = json_boolean_value(json_object_get(voiceJ, "mutationKeepHits"));
+        mutationLocked = json_boolean_value(json_object_get(voiceJ, "mutationLocked"));
+        mutatedValid = mutationLocked && mutated.fromJson(json_object_get(voiceJ, "mutated"), maxLength);
+
+        json_t* morphAmountJ = json_object_get(voiceJ, "morphAmount");
+        if (morphAmountJ) morphAmount = clamp(static_cast<float>(json_number_value(morphAmountJ)), 0.0f, 1.0f);
+
+        morphAValid = morphA.fromJson(json_object_get(voiceJ, "morphA"), maxLength);
+        morphBValid = morphB.fromJson(json_object_get(voiceJ, "morphB"), maxLength);
+        morphing = json_boolean_value(json_object_get(voiceJ, "morphing")) && canMorph();
+        morphDirty = true;
+        morphNode = -1;
+    }
+
+    // Voz de otro ancho (cambio de longitud máxima): los ajustes y el estado
+    // pasan tal cual; el patrón y los estados precalculados se recortan a
+    // MAX_LEN pasos y los que ya no caben se descartan. El camino del morph
+    // se recalcula.
+    template <unsigned int FROM>
+    void assign(const VoiceT<FROM>& from) {
+        static_cast<VoiceBase&>(*this) = from;
+        sequence = resizeMask<MAX_LEN>(from.sequence);
+        accents = resizeMask<MAX_LEN>(from.accents);
+        hitGate = resizeMask<MAX_LEN>(from.hitGate);
+        accentGate = resizeMask<MAX_LEN>(from.accentGate);
+        mutated.template assign<FROM>(from.mutated);
+        morphA.template assign<FROM>(from.morphA);
+        morphB.template assign<FROM>(from.morphB);
+        mutatedValid = mutatedValid && mutated.fits(MAX_LEN);
+        morphAValid = morphAValid && morphA.fits(MAX_LEN);
+        morphBValid = morphBValid && morphB.fits(MAX_LEN);
+        morphing = morphing && canMorph();
+        morphDirty = true;
+        morphNode = -1;
+    }
+};
+
+// Métricas de ANALYSIS_OUTPUT: un bloque de NUM_VOICES_MAX canales por
+// métrica (densidad, regularidad, síncopa, fase en el ciclo maestro)
+static const int NUM_ANALYSIS = 4;
+
+// Número de salidas compuestas (canales de COMPOSITE_OUTPUT)
+static const int NUM_COMPOSITES = 4;
+
+// Combinación booleana de los bits de paso actuales de las voces.
+// La función se precalcula como tabla de verdad de 16 bits indexada por
+// la palabra de estado (bit v = hit en el paso actual de la voz v), de modo
+// que evaluarla en process() es un solo desplazamiento y máscara.
+struct Composite {
+    enum Op {
+        OR_OP,   // alguna de las voces incluidas
+        AND_OP,  // todas las voces incluidas
+        XOR_OP,  // número impar de voces incluidas
+        NUM_OPS
+    };
+
+    Op op = OR_OP;
+    unsigned int include = 0xf;  // voces combinadas con op
+    unsigned int exclude = 0x0;  // voces negadas (AND NOT)
+    uint16_t table = 0;
+
+    dsp::PulseGenerator pulse;
+    bool on = false;
+
+    Composite() { update(); }
+    Composite(Op op_, unsigned int include_, unsigned int exclude_)
+        : op(op_), include(include_), exclude(exclude_) { update(); }
+
+    // Recalcula la tabla de verdad tras un cambio de configuración
+    void update() {
+        table = 0;
+        for (unsigned int state = 0; state < (1u << NUM_VOICES_MAX); state++) {
+            unsigned int in = state & include;
+            bool value;
+            switch (op) {
+                case AND_OP: value = (in == include); break;
+                case XOR_OP: value = __builtin_parity(in); break;
+                default: value = include ? (in != 0) : true; break;
+            }
+            if (state & exclude) value = false;
+            if (value) table |= 1u << state;
+        }
+    }
+
+    bool eval(unsigned int state) const { return (table >> state) & 1; }
+
+    static const char* opName(Op op) {
+        static const char* names[NUM_OPS] = {"OR", "AND", "XOR"};
+        return names[op];
+    }
+
+    json_t* toJson() {
+        json_t* compositeJ = json_object();
+        if (!compositeJ) return nullptr;
+        json_object_set_new(compositeJ, "op", json_integer(op));
+        json_object_set_new(compositeJ, "include", json_integer(include));
+        json_object_set_new(compositeJ, "exclude", json_integer(exclude));
+        return compositeJ;
+    }
+
+    void fromJson(json_t* compositeJ) {
+        if (!compositeJ) return;
+        json_t* opJ = json_object_get(compositeJ, "op");
+        if (opJ) op = static_cast<Op>(clamp(static_cast<int>(json_integer_value(opJ)), 0, NUM_OPS - 1));
+        json_t* includeJ = json_object_get(compositeJ, "include");
+        if (includeJ) include = json_integer_value(includeJ) & 0xf;
+        json_t* excludeJ = json_object_get(compositeJ, "exclude");
+        if (excludeJ) exclude = json_integer_value(excludeJ) & 0xf;
+        update();
     }
 };
 
@@ -143,6 +972,15 @@ struct Puya : Module {
       CLK_INPUT,
       RESET_INPUT,
       RND_INPUT,
+      // Entradas del expansor (PuyaExpander), en el orden de su mensaje
+      RATCHET_INPUT,
+      BANK_INPUT,
+      MORPH_INPUT,
+      MUTATE_INPUT,
+      GATE_LENGTH_INPUT,
+      ACCENT_LENGTH_INPUT,
+      RATIO_INPUT,
+      PATTERN_INPUT,
       NUM_INPUTS
   };
 
@@ -151,9 +989,21 @@ struct Puya : Module {
       ACCENT_OUTPUT,
       CLK_OUTPUT,
       RESET_OUTPUT,
+      // Salidas del expansor, en el orden de PuyaBusMessage::outputs
+      COMPOSITE_OUTPUT,
+      ANALYSIS_OUTPUT,
+      MASTER_PHASE_OUTPUT,
+      MASTER_END_OUTPUT,
       NUM_OUTPUTS
   };
 
+  // Los puertos del expansor no tienen conector en el panel de Puya: se
+  // reflejan en cada muestra desde y hacia PuyaExpander (ver readExpander)
+  static_assert(NUM_INPUTS - RATCHET_INPUT == PuyaExpanderMessage::NUM_INPUTS,
+                "entradas del expansor");
+  static_assert(NUM_OUTPUTS - COMPOSITE_OUTPUT == PuyaBusMessage::NUM_OUTPUTS,
+                "salidas del expansor");
+
   enum LightIds {
       CLK_LIGHT,
       GATE_LIGHT,
@@ -173,11 +1023,176 @@ struct Puya : Module {
   enum gateModes {
       TRIGGER_MODE,
       GATE_MODE,
-      TURING_MODE
+      TURING_MODE,
+      AUDIO_MODE
   } gateMode = TRIGGER_MODE;
 
-  // Gestión de voces y patrones
-  std::array<Voice, NUM_VOICES_MAX> voices;
+  // Ciclo de trabajo de los hits en modo audio (fracción del periodo)
+  static constexpr float AUDIO_DUTY = 0.5f;
+
+  // Escaneo de parámetros y luces a tasa reducida
+  dsp::ClockDivider paramDivider;
+  dsp::ClockDivider lightDivider;
+
+  // Contadores de rendimiento (ver PuyaStats.hpp). statsBase es la línea
+  // base de "Reiniciar contadores" y sólo la toca la interfaz.
+  PuyaStats stats;
+  PuyaStats::Snapshot statsBase;
+  bool statsLog = false;  // línea periódica en el log de Rack
+
+  // Traza de entradas (ver PuyaTrace.hpp). Cada entrada ocupa
+  // TRACE_CHANNELS señales: el voltaje de cada voz y el número de canales;
+  // detrás van los parámetros.
+  static const int TRACE_CHANNELS = NUM_VOICES_MAX + 1;
+  static const int NUM_TRACE_SIGNALS = NUM_INPUTS * TRACE_CHANNELS + NUM_PARAMS;
+  PuyaTraceRecorder trace{NUM_TRACE_SIGNALS};
+
+  // Reproducción de una traza en un Puya aparte, en un hilo propio. La
+  // interfaz sólo lee replayResult cuando replayBusy está apagado.
+  struct ReplayResult {
+      bool valid = false;
+      std::string path;
+      uint64_t frames = 0;
+      float sampleRate = 0.0f;
+      double seconds = 0.0;       // duración de la traza
+      double wallSeconds = 0.0;   // tiempo de reproducción
+      double averageNanos = 0.0;  // process() por muestra
+      double maxNanos = 0.0;
+      uint64_t maxFrame = 0;      // muestra del máximo
+      uint64_t regenerations = 0;
+      uint64_t hash = 0;          // FNV-1a de todas las salidas, muestra a muestra
+  };
+  ReplayResult replayResult;
+  std::thread replayThread;
+  std::atomic<bool> replayBusy{false};
+  std::atomic<bool> replayAbort{false};
+
+  // Display: sólo la voz seleccionada o las cuatro superpuestas
+  bool overlayDisplay = false;
+
+  // Longitud máxima del ciclo elegida en el menú (32, 64 o 128 pasos):
+  // par_l llega hasta la mitad y par_p rellena hasta maxLength. Sólo la
+  // cambia el hilo de audio; el menú la pide en pendingMaxLength y
+  // process() la aplica al principio de la muestra siguiente.
+  unsigned int maxLength = 32;
+  std::atomic<unsigned int> pendingMaxLength{0};  // 0 = sin petición
+
+  // Voces de cada ancho de máscara. Sólo las de maxLength están activas:
+  // process() elige su especialización una vez por muestra y el resto del
+  // hilo de audio trabaja con ella; setMaxLength pasa las voces de un ancho
+  // a otro. Las inactivas sólo guardan memoria.
+  template <unsigned int N>
+  using Voices = std::array<VoiceT<N>, NUM_VOICES_MAX>;
+
+  template <unsigned int N>
+  struct VoiceSet {
+      Voices<N> voices;
+  };
+  struct VoiceSets : VoiceSet<32>, VoiceSet<64>, VoiceSet<128> {};
+  VoiceSets voiceSets;
+
+  template <unsigned int N>
+  Voices<N>& voicesOf() {
+      return static_cast<VoiceSet<N>&>(voiceSets).voices;
+  }
+
+  template <unsigned int N>
+  const Voices<N>& voicesOf() const {
+      return static_cast<const VoiceSet<N>&>(voiceSets).voices;
+  }
+
+  // Voz v del ancho activo, para lo que no depende de las máscaras
+  // (menús, display, enrutamiento)
+  VoiceBase& activeVoice(int v) {
+      switch (maxLength) {
+          case 32: return voicesOf<32>()[v];
+          case 64: return voicesOf<64>()[v];
+          default: return voicesOf<128>()[v];
+      }
+  }
+
+  const VoiceBase& activeVoice(int v) const {
+      switch (maxLength) {
+          case 32: return voicesOf<32>()[v];
+          case 64: return voicesOf<64>()[v];
+          default: return voicesOf<128>()[v];
+      }
+  }
+
+  // Peticiones del menú para cada voz. La interfaz no toca las voces: deja
+  // aquí lo pedido y process() lo aplica al principio de la muestra
+  // siguiente (ver applyVoiceRequests).
+  struct VoiceRequests {
+      // Modo catálogo y modo banco: -1 = sin petición, 0 = apagar,
+      // 1 = encender
+      std::atomic<int> catalog{-1};
+      std::atomic<int> patternBank{-1};
+      // Parámetros de "Buscar parámetros" (ver packMatch), 0 = sin petición
+      std::atomic<uint64_t> parameters{0};
+
+      void clear() {
+          catalog = -1;
+          patternBank = -1;
+          parameters = 0;
+      }
+  };
+  std::array<VoiceRequests, NUM_VOICES_MAX> voiceRequests;
+
+  // Salidas compuestas
+  std::array<Composite, NUM_COMPOSITES> composites;
+
+  // Ciclo maestro: mcm de los ciclos de las voces con reloj maestro (en
+  // pulsos) y posición del último pulso dentro de él (ver advanceMaster)
+  uint32_t masterCycle = 1;
+  std::array<uint32_t, NUM_VOICES_MAX> masterLengths = {};
+  uint32_t masterStep = 0;
+  bool masterRestart = true;   // el próximo paso maestro es el 0
+  int masterVoice = 0;         // referencia: la voz de menor índice con reloj maestro
+  dsp::PulseGenerator masterEndPulse;
+
+  // Hay un PuyaExpander a la derecha y sus puertos se están reflejando
+  bool expanderAttached = false;
+
+  // Sincronización del botón Sync: inmediata o en cola hasta el próximo
+  // tiempo fuerte (inicio de ciclo de la referencia) o ciclo maestro
+  enum SyncMode {
+      SYNC_NOW,
+      SYNC_ON_DOWNBEAT,
+      SYNC_ON_MASTER
+  } syncMode = SYNC_NOW;
+  bool syncQueued = false;
+
+  // Ventana de arbitraje de RESET_INPUT, en muestras: un reset que llega
+  // hasta resetWindow muestras después de un pulso de reloj convierte ese
+  // pulso en el paso 0 (ver resetPlayback)
+  static const uint32_t RESET_WINDOWS[];
+  static const int NUM_RESET_WINDOWS = 7;
+  uint32_t resetWindow = 4;
+
+  // Banco de instantáneas: patrón calculado de las cuatro voces, en el
+  // ancho máximo para que sobreviva a los cambios de longitud máxima
+  typedef VoiceT<MAX_SEQUENCE_LEN>::State SnapshotState;
+  struct Snapshot {
+      bool valid = false;
+      SnapshotState voices[NUM_VOICES_MAX];
+  };
+  std::array<Snapshot, NUM_SNAPSHOTS> snapshots;
+
+  // Banco de patrones externo. El archivo sólo se toca desde el hilo de la
+  // interfaz (loadPatternBank, servicePatternBank); el de audio ve el
+  // número de entradas y las entradas publicadas en bankSlots. Quien
+  // atiende las peticiones es PuyaWidget::step() (replayTrace en la
+  // reproducción de trazas): sin widget el modo banco no recibe entradas
+  // nuevas (ver resetVoice).
+  PatternFile patternFile;
+  std::array<PatternBankSlot, NUM_VOICES_MAX> bankSlots;
+  std::atomic<uint32_t> bankSize{0};
+  std::atomic<uint32_t> bankGeneration{0};
+
+  // Orden de proceso de las voces: cada voz después de la que la cronometra.
+  // Se recalcula en el hilo de audio cuando routingDirty está activo.
+  std::array<int, NUM_VOICES_MAX> voiceOrder = {{0, 1, 2, 3}};
+  bool routingDirty = true;
   int currentVoice = 0;
   Bjorklund euclid;
   Bjorklund euclid2;
@@ -233,8 +1248,12 @@ struct Puya : Module {
       for (int i = 0; i < NUM_OUTPUTS; i++) {
           outputs[i].setChannels(NUM_VOICES_MAX);
       }
+      outputs[ANALYSIS_OUTPUT].setChannels(NUM_ANALYSIS * NUM_VOICES_MAX);
+      outputs[MASTER_PHASE_OUTPUT].setChannels(1);
+      outputs[MASTER_END_OUTPUT].setChannels(1);
   
-      // Inicializar todas las voces
+      // Inicializar todas las voces (maxLength empieza en 32 pasos)
+      Voices<32>& voices = voicesOf<32>();
       for (int v = 0; v < NUM_VOICES_MAX; v++) {
           voices[v].reset();
           resetVoice(voices[v]);
@@ -252,8 +1271,20 @@ struct Puya : Module {
                              voices[v].par_r + voices[v].par_p + 
                              voices[v].par_s + voices[v].par_a;
           voices[v].calculate = true;
+          voices[v].seedRandom(random::u64());
       }
   
+      // Generar el catálogo fuera del hilo de audio
+      necklaces();
+
+      // Doble buffer del bus de expansión (lo leen los expansores de la derecha)
+      rightExpander.producerMessage = new PuyaBusMessage;
+      rightExpander.consumerMessage = new PuyaBusMessage;
+
+      paramDivider.setDivision(32);
+      lightDivider.setDivision(16);
+      statsBase = stats.snapshot();
+
       // Configurar el botón de sync como momentáneo (0=off, 1=on)
     configParam(SYNC_PARAM, 0.0f, 1.0f, 0.0f, "Sync");
     
@@ -264,11 +1295,14 @@ struct Puya : Module {
   
       onReset();
   }
-  
-  unsigned int fib(unsigned int n) {
-      return (n < 2) ? n : fib(n - 1) + fib(n - 2);
-  }
 
+  ~Puya() {
+      replayAbort.store(true, std::memory_order_relaxed);
+      if (replayThread.joinable()) replayThread.join();
+      delete static_cast<PuyaBusMessage*>(rightExpander.producerMessage);
+      delete static_cast<PuyaBusMessage*>(rightExpander.consumerMessage);
+  }
+  
   // Métodos de serialización JSON
   json_t* dataToJson() override {
       json_t* rootJ = json_object();
@@ -278,6 +1312,14 @@ struct Puya : Module {
       json_object_set_new(rootJ, "mode", json_integer(static_cast<int>(gateMode)));
       json_object_set_new(rootJ, "style", json_integer(static_cast<int>(style)));
       json_object_set_new(rootJ, "currentVoice", json_integer(currentVoice));
+      json_object_set_new(rootJ, "maxLength", json_integer(maxLength));
+      json_object_set_new(rootJ, "statsLog", json_boolean(statsLog));
+      json_object_set_new(rootJ, "overlayDisplay", json_boolean(overlayDisplay));
+      json_object_set_new(rootJ, "syncMode", json_integer(syncMode));
+      json_object_set_new(rootJ, "resetWindow", json_integer(resetWindow));
+      if (patternFile.isOpen()) {
+          json_object_set_new(rootJ, "patternBankPath", json_string(patternFile.path().c_str()));
+      }
 
       // Guarda estados de las voces
       json_t* voicesJ = json_array();
@@ -286,14 +1328,42 @@ struct Puya : Module {
           return nullptr;
       }
 
-      for (int i = 0; i < NUM_VOICES_MAX; i++) {
-          json_t* voiceJ = voices[i].toJson();
-          if (voiceJ) {
-              json_array_append_new(voicesJ, voiceJ);
-          }
+      switch (maxLength) {
+          case 32: voicesToJson(voicesOf<32>(), voicesJ); break;
+          case 64: voicesToJson(voicesOf<64>(), voicesJ); break;
+          default: voicesToJson(voicesOf<128>(), voicesJ); break;
       }
       json_object_set_new(rootJ, "voices", voicesJ);
 
+      // Guarda la configuración de las salidas compuestas
+      json_t* compositesJ = json_array();
+      if (compositesJ) {
+          for (auto& composite : composites) {
+              json_t* compositeJ = composite.toJson();
+              if (compositeJ) {
+                  json_array_append_new(compositesJ, compositeJ);
+              }
+          }
+          json_object_set_new(rootJ, "composites", compositesJ);
+      }
+
+      // Guarda el banco de instantáneas (null = ranura vacía)
+      json_t* snapshotsJ = json_array();
+      if (snapshotsJ) {
+          for (const Snapshot& snapshot : snapshots) {
+              if (!snapshot.valid) {
+                  json_array_append_new(snapshotsJ, json_null());
+                  continue;
+              }
+              json_t* snapshotJ = json_array();
+              for (int v = 0; v < NUM_VOICES_MAX; v++) {
+                  json_array_append_new(snapshotJ, snapshot.voices[v].toJson());
+              }
+              json_array_append_new(snapshotsJ, snapshotJ);
+          }
+          json_object_set_new(rootJ, "snapshots", snapshotsJ);
+      }
+
       return rootJ;
   }
 
@@ -316,37 +1386,288 @@ struct Puya : Module {
           currentVoice = clamp(json_integer_value(currentVoiceJ), 0, NUM_VOICES_MAX - 1);
       }
 
-      // Carga estados de las voces
-      json_t* voicesJ = json_object_get(rootJ, "voices");
-      if (voicesJ) {
-          size_t voiceCount = std::min(static_cast<size_t>(json_array_size(voicesJ)), 
-                                     static_cast<size_t>(NUM_VOICES_MAX));
-          for (size_t i = 0; i < voiceCount; i++) {
-              json_t* voiceJ = json_array_get(voicesJ, i);
-              if (voiceJ) {
-                  voices[i].fromJson(voiceJ);
-              }
-          }
+      // El patch cargado manda sobre las peticiones del menú sin aplicar
+      pendingMaxLength = 0;
+      for (auto& requests : voiceRequests) {
+          requests.clear();
+      }
+      json_t* maxLengthJ = json_object_get(rootJ, "maxLength");
+      if (maxLengthJ) {
+          setMaxLength(json_integer_value(maxLengthJ));
       }
-  }
 
-  float getParameterizedVoltage(int input_id, int voice) {
-    return inputs[input_id].getPolyVoltage(voice);
-  }
+      statsLog = json_boolean_value(json_object_get(rootJ, "statsLog"));
+      overlayDisplay = json_boolean_value(json_object_get(rootJ, "overlayDisplay"));
 
-  void onReset() override {
-    // Reiniciar estado del módulo
-    gateMode = TRIGGER_MODE;
-    style = EUCLIDEAN_PATTERN;
-    currentVoice = 0;
+      json_t* syncModeJ = json_object_get(rootJ, "syncMode");
+      if (syncModeJ) {
+          syncMode = static_cast<SyncMode>(clamp(static_cast<int>(json_integer_value(syncModeJ)), 0, 2));
+      }
 
-    for (auto& voice : voices) {
-        voice.reset();
-       resetVoice(voice);
-    }
+      json_t* resetWindowJ = json_object_get(rootJ, "resetWindow");
+      if (resetWindowJ) {
+          resetWindow = clamp(static_cast<int>(json_integer_value(resetWindowJ)), 0, 32);
+      }
+
+      json_t* patternBankPathJ = json_object_get(rootJ, "patternBankPath");
+      if (patternBankPathJ) {
+          loadPatternBank(json_string_value(patternBankPathJ));
+      }
+
+      json_t* compositesJ = json_object_get(rootJ, "composites");
+      if (compositesJ) {
+          size_t compositeCount = std::min(static_cast<size_t>(json_array_size(compositesJ)),
+                                         static_cast<size_t>(NUM_COMPOSITES));
+          for (size_t i = 0; i < compositeCount; i++) {
+              composites[i].fromJson(json_array_get(compositesJ, i));
+          }
+      }
+
+      // Instantáneas: se descartan las que no caben en maxLength
+      json_t* snapshotsJ = json_object_get(rootJ, "snapshots");
+      for (int i = 0; i < NUM_SNAPSHOTS; i++) {
+          json_t* snapshotJ = snapshotsJ ? json_array_get(snapshotsJ, i) : nullptr;
+          Snapshot& snapshot = snapshots[i];
+          snapshot.valid = json_is_array(snapshotJ) && json_array_size(snapshotJ) == NUM_VOICES_MAX;
+          for (int v = 0; v < NUM_VOICES_MAX && snapshot.valid; v++) {
+              snapshot.valid = snapshot.voices[v].fromJson(json_array_get(snapshotJ, v), maxLength);
+          }
+      }
+
+      routingDirty = true;
+
+      json_t* voicesJ = json_object_get(rootJ, "voices");
+      switch (maxLength) {
+          case 32: voicesFromJson(voicesOf<32>(), voicesJ); break;
+          case 64: voicesFromJson(voicesOf<64>(), voicesJ); break;
+          default: voicesFromJson(voicesOf<128>(), voicesJ); break;
+      }
   }
 
+  template <unsigned int N>
+  static void voicesToJson(Voices<N>& voices, json_t* voicesJ) {
+      for (int i = 0; i < NUM_VOICES_MAX; i++) {
+          json_t* voiceJ = voices[i].toJson();
+          if (voiceJ) {
+              json_array_append_new(voicesJ, voiceJ);
+          }
+      }
+  }
+
+  // Carga estados de las voces activas
+  template <unsigned int N>
+  void voicesFromJson(Voices<N>& voices, json_t* voicesJ) {
+      if (voicesJ) {
+          size_t voiceCount = std::min(static_cast<size_t>(json_array_size(voicesJ)), 
+                                     static_cast<size_t>(NUM_VOICES_MAX));
+          for (size_t i = 0; i < voiceCount; i++) {
+              json_t* voiceJ = json_array_get(voicesJ, i);
+              if (voiceJ) {
+                  voices[i].fromJson(voiceJ);
+                  voices[i].statesFromJson(voiceJ, maxLength);
+              }
+          }
+      }
+
+      // Regenerar todas las voces con los parámetros cargados; un patrón
+      // mutado bloqueado sustituye al generado. Las probabilidades cargadas
+      // se sortean ya para el ciclo en curso.
+      for (auto& voice : voices) {
+          voice.clampParameters(maxLength);
+          resetVoice(voice);
+          if (voice.mutatedValid) {
+              voice.restore(voice.mutated);
+              voice.mutatedValid = false;
+          }
+          rollProbabilities(voice, &voice - &voices[0]);
+      }
+  }
+
+  // Cambia la longitud máxima del ciclo: 32, 64 o 128 pasos
+  void setMaxLength(unsigned int length) {
+      if (length <= 32) setMaxLength(voicesOf<32>());
+      else if (length <= 64) setMaxLength(voicesOf<64>());
+      else setMaxLength(voicesOf<128>());
+  }
+
+  // Pasa las voces activas a las de N pasos, que quedan activas, y las
+  // acota al ciclo nuevo
+  template <unsigned int N>
+  void setMaxLength(Voices<N>& voices) {
+      if (maxLength == N) return;
+      switch (maxLength) {
+          case 32: assignVoices(voices, voicesOf<32>()); break;
+          case 64: assignVoices(voices, voicesOf<64>()); break;
+          default: assignVoices(voices, voicesOf<128>()); break;
+      }
+      maxLength = N;
+      // El sorteo de probabilidades del ancho anterior no cubre los pasos
+      // nuevos: se repite para el ciclo en curso
+      for (auto& voice : voices) {
+          voice.clampParameters(maxLength);
+          resetVoice(voice);
+          rollProbabilities(voice, &voice - &voices[0]);
+      }
+  }
+
+  template <unsigned int N, unsigned int M>
+  static void assignVoices(Voices<N>& to, const Voices<M>& from) {
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          to[v].assign(from[v]);
+      }
+  }
+
+  // Mapeos de perilla a parámetro dependientes de maxLength
+  float maxPatternLength() const {
+      return static_cast<float>(maxLength / 2);
+  }
+
+  // En modo catálogo la longitud no supera la del catálogo
+  float maxVoiceLength(const VoiceBase& voice) const {
+      return voice.catalog ? std::min(maxPatternLength(), static_cast<float>(NECKLACE_MAX_LEN)) : maxPatternLength();
+  }
+
+  unsigned int mapLength(const VoiceBase& voice, float x) const {
+      return static_cast<unsigned int>(1.0f + (maxVoiceLength(voice) - 1.0f) * x);
+  }
+
+  // Hits a partir de K. En modo catálogo K elige el collar de longitud
+  // par_l y los hits son los del collar (al menos 1, para A y S)
+  unsigned int mapHits(VoiceBase& voice, float x) {
+      if (voice.catalog) {
+          voice.necklaceId = necklaces().select(voice.par_l, clamp(x, 0.0f, 1.0f));
+          return std::max(1u, necklaces().hits(voice.necklaceId));
+      }
+      return static_cast<unsigned int>(1.0f + (voice.par_l - 1.0f) * x);
+  }
+
+  // Activa o desactiva el modo catálogo conservando el patrón más cercano:
+  // el collar se elige con la posición relativa de K en la longitud actual
+  // (hilo de audio, ver requestCatalog)
+  template <typename Voice>
+  void setCatalog(Voice& voice, bool catalog) {
+      voice.catalog = catalog;
+      voice.literal = false;
+      voice.clampParameters(maxLength);
+      if (catalog) {
+          float x = (voice.par_l > 1) ? (voice.par_k - 1.0f) / (voice.par_l - 1.0f) : 0.0f;
+          voice.par_k = mapHits(voice, x);
+          voice.par_a = std::min(voice.par_a, voice.par_k);
+          voice.par_s = voice.par_a ? std::min(voice.par_s, voice.par_k - 1) : 0;
+      }
+      voice.calculate = true;
+      resetVoice(voice);
+  }
+
+  // Interfaz: pide activar o desactivar el modo catálogo de la voz v
+  void requestCatalog(int v, bool catalog) {
+      voiceRequests[v].catalog = catalog ? 1 : 0;
+  }
+
+  unsigned int mapPad(unsigned int l, float x) const {
+      return static_cast<unsigned int>((static_cast<float>(maxLength) - l) * x);
+  }
+
+  float getParameterizedVoltage(int input_id, int voice) {
+    return inputs[input_id].getPolyVoltage(voice);
+  }
+
+  void onReset() override {
+    // Reiniciar estado del módulo
+    gateMode = TRIGGER_MODE;
+    style = EUCLIDEAN_PATTERN;
+    currentVoice = 0;
+    pendingMaxLength = 0;
+    for (auto& requests : voiceRequests) {
+        requests.clear();
+    }
+    setMaxLength(32);
+    resetComposites();
+
+    for (auto& snapshot : snapshots) {
+        snapshot.valid = false;
+    }
+
+    Voices<32>& voices = voicesOf<32>();
+    for (auto& voice : voices) {
+        voice.clockSource = VoiceBase::CLOCK_MASTER;
+        voice.pendingSnapshot = -1;
+    }
+    routingDirty = true;
+
+    // Primer sorteo de probabilidades: el primer ciclo también las respeta
+    for (auto& voice : voices) {
+        voice.reset();
+       resetVoice(voice);
+       rollProbabilities(voice, &voice - &voices[0]);
+    }
+  }
+
+  // Regenera todas las voces activas (cambio de estilo)
+  void resetVoices() {
+      switch (maxLength) {
+          case 32: resetVoices(voicesOf<32>()); break;
+          case 64: resetVoices(voicesOf<64>()); break;
+          default: resetVoices(voicesOf<128>()); break;
+      }
+  }
+
+  template <unsigned int N>
+  void resetVoices(Voices<N>& voices) {
+      for (auto& voice : voices) {
+          resetVoice(voice);
+      }
+  }
+
+  // Interfaz: patrón de la voz v en máscaras del ancho máximo (display)
+  void copyPattern(int v, StepMask<MAX_SEQUENCE_LEN>& sequence, StepMask<MAX_SEQUENCE_LEN>& accents) const {
+      switch (maxLength) {
+          case 32: copyPattern(voicesOf<32>()[v], sequence, accents); break;
+          case 64: copyPattern(voicesOf<64>()[v], sequence, accents); break;
+          default: copyPattern(voicesOf<128>()[v], sequence, accents); break;
+      }
+  }
+
+  template <unsigned int N>
+  static void copyPattern(const VoiceT<N>& voice, StepMask<MAX_SEQUENCE_LEN>& sequence,
+                          StepMask<MAX_SEQUENCE_LEN>& accents) {
+      sequence = resizeMask<MAX_SEQUENCE_LEN>(voice.sequence);
+      accents = resizeMask<MAX_SEQUENCE_LEN>(voice.accents);
+  }
+
+  // Combinaciones por defecto: unión, intersección, XOR y voz 1 sin voz 2
+  void resetComposites() {
+    composites[0] = Composite(Composite::OR_OP, 0xf, 0x0);
+    composites[1] = Composite(Composite::AND_OP, 0xf, 0x0);
+    composites[2] = Composite(Composite::XOR_OP, 0xf, 0x0);
+    composites[3] = Composite(Composite::OR_OP, 0x1, 0x2);
+  }
+
+  template <typename Voice>
   void resetVoice(Voice& voice) {
+    PuyaStats::RegenerationTimer timer(stats);
+    int v = &voice - &voicesOf<Voice::WIDTH>()[0];
+
+    // Modo banco: el patrón es la entrada cargada (o la pedida), no se
+    // genera. Sin entrada publicada se conserva la anterior si cabe y, si
+    // no, la voz queda en silencio: los parámetros salen de una entrada y
+    // no deben generar un patrón de estilo.
+    if (voice.patternBank) {
+        if (!loadBankEntry(voice, v, voice.bankEntry) && !loadBankEntry(voice, v, voice.bankWanted) && !voice.literal) {
+            voice.sequence.reset();
+            voice.accents.reset();
+            voice.clampParameters(maxLength);
+            voice.setLiteral(voice.par_l + voice.par_p, maxLength);
+        }
+        return;
+    }
+
+    // Patrón literal: los parámetros no lo generan, se conserva
+    if (voice.literal) {
+        voice.calculate = false;
+        return;
+    }
+
     // Redimensionar secuencias si cambiaron los parámetros
     if (voice.par_l_last != voice.par_l) {
        std::fill(voice.seq0.begin(), voice.seq0.end(), false);
@@ -358,7 +1679,12 @@ struct Puya : Module {
        voice.acc0.resize(voice.par_k);
    }
 
-   // Generar patrón según el estilo
+   // Modo catálogo: el collar sustituye al estilo
+   if (voice.catalog) {
+       generateNecklacePattern(voice);
+       stats.stage(v, PuyaStats::CATALOG_STAGE);
+   } else {
+    // Generar patrón según el estilo
     switch (style) {
        case RANDOM_PATTERN:
            generateRandomPattern(voice);
@@ -379,17 +1705,23 @@ struct Puya : Module {
             break;
    }
 
+   stats.stage(v, PuyaStats::PATTERN_STAGE);
+
    distributeAccents(voice);
+   stats.stage(v, PuyaStats::ACCENT_STAGE);
+   }
+   stats.regeneration(v);
 
     // Actualizar estado
    voice.calculate = false;
+   voice.analysisDirty = true;
    voice.par_k_last = voice.par_k;
     voice.par_l_last = voice.par_l;
    voice.par_a_last = voice.par_a;
   }
 
   // Métodos de generación de patrones
-  void generateRandomPattern(Voice& voice) {
+  void generateRandomPattern(VoiceBase& voice) {
    voice.seq0.resize(voice.par_l);
    std::fill(voice.seq0.begin(), voice.seq0.end(), false);
     
@@ -402,9 +1734,10 @@ struct Puya : Module {
        }
        n++;
     }
+   PuyaStats::add(stats.randomIterations, n);
   }
 
-  void generateRandomAccents(Voice& voice) {
+  void generateRandomAccents(VoiceBase& voice) {
    voice.acc0.resize(voice.par_k);
    std::fill(voice.acc0.begin(), voice.acc0.end(), false);
     
@@ -417,89 +1750,118 @@ struct Puya : Module {
        }
        n++;
    }
+   PuyaStats::add(stats.randomIterations, n);
   }
 
+  template <typename Voice>
   void generateFibonacciPattern(Voice& voice) {
-    // Generar secuencia principal
-   voice.seq0.resize(voice.par_l);
-    std::fill(voice.seq0.begin(), voice.seq0.end(), false);
-    for (unsigned int k = 0; k < voice.par_k; k++) {
-       voice.seq0.at(fib(k) % voice.par_l) = true;
-   }
-
-   // Generar acentos
-   voice.acc0.resize(voice.par_k);
-   std::fill(voice.acc0.begin(), voice.acc0.end(), false);
-    for (unsigned int a = 0; a < voice.par_a; a++) {
-       voice.acc0.at(fib(a) % voice.par_k) = true;
-   }
+    Voice::Engine::fibonacci(voice.par_l, voice.par_k, voice.par_a, voice.seq0, voice.acc0);
   }
 
+  template <typename Voice>
   void generateLinearPattern(Voice& voice) {
-   // Generar secuencia principal
-   voice.seq0.resize(voice.par_l);
-   std::fill(voice.seq0.begin(), voice.seq0.end(), false);
-   for (unsigned int k = 0; k < voice.par_k; k++) {
-       voice.seq0.at(voice.par_l * k / voice.par_k) = true;
-   }
-
-   // Generar acentos
-   voice.acc0.resize(voice.par_k);
-   std::fill(voice.acc0.begin(), voice.acc0.end(), false);
-   for (unsigned int a = 0; a < voice.par_a; a++) {
-       voice.acc0.at(voice.par_k * a / voice.par_a) = true;
-   }
+    Voice::Engine::linear(voice.par_l, voice.par_k, voice.par_a, voice.seq0, voice.acc0);
   }
 
-  void generateEuclideanPattern(Voice& voice) {
-    // Generar secuencia principal
-    voice.euclid.reset();
-    voice.euclid.init(voice.par_l, voice.par_k);
-    voice.euclid.iter();
-    voice.seq0 = voice.euclid.sequence;
-
-    // Generar acentos si es necesario
-    if (voice.par_a > 0) {
+  // Collar del catálogo: los acentos se reparten de forma euclidiana entre
+  // sus hits (par_k ya es la cantidad de hits del collar)
+  template <typename Voice>
+  void generateNecklacePattern(Voice& voice) {
+    const Necklaces& catalog = necklaces();
+    uint32_t steps = catalog.steps(voice.necklaceId);
+    unsigned int l = catalog.length(voice.necklaceId);
+    unsigned int k = catalog.hits(voice.necklaceId);
+
+    voice.seq0.assign(l, false);
+    for (unsigned int i = 0; i < l; i++) {
+        voice.seq0[i] = (steps >> i) & 1;
+    }
+
+    unsigned int a = 0;
+    unsigned int s = 0;
+    voice.acc0.clear();
+    if (k > 0 && voice.par_a > 0) {
+        a = std::min(voice.par_a, k);
+        s = std::min(voice.par_s, k - 1);
         voice.euclid2.reset();
-        voice.euclid2.init(voice.par_k, voice.par_a);
+        voice.euclid2.init(k, a);
         voice.euclid2.iter();
         voice.acc0 = voice.euclid2.sequence;
     }
+
+    Voice::Engine::distributeAccents(voice.seq0, voice.acc0, l, k, a, s,
+                                     voice.par_r, voice.par_p,
+                                     voice.sequence, voice.accents);
   }
 
+  template <typename Voice>
+  void generateEuclideanPattern(Voice& voice) {
+    Voice::Engine::euclidean(voice.par_l, voice.par_k, voice.par_a,
+                             voice.euclid, voice.euclid2, voice.seq0, voice.acc0);
+  }
+
+  template <typename Voice>
   void distributeAccents(Voice& voice) {
-    unsigned int j = voice.par_k - voice.par_s;
-    for (unsigned int i = 0; i < voice.seq0.size(); i++) {
-        unsigned int idx = (i + voice.par_r) % (voice.par_l + voice.par_p);
-        voice.sequence[idx] = voice.seq0.at(i);
-        voice.accents[idx] = false;
-        if (voice.par_a && voice.seq0.at(i)) {
-            voice.accents[idx] = voice.acc0.at(j % voice.par_k);
-            j++;
-        }
-    }
+    Voice::Engine::distributeAccents(voice.seq0, voice.acc0,
+                                     voice.par_l, voice.par_k, voice.par_a,
+                                     voice.par_s, voice.par_r, voice.par_p,
+                                     voice.sequence, voice.accents);
   }
 
     // Métodos de procesamiento y actualización
     void process(const ProcessArgs& args) override {
-      
+      PuyaStats::ProcessTimer timer(stats);
+
+      // Cambio de longitud máxima pedido desde el menú
+      unsigned int length = pendingMaxLength.exchange(0);
+      if (length) {
+          setMaxLength(length);
+      }
+
+      readExpander();
+      if (trace.beginFrame()) {
+          recordTraceFrame();
+      }
+
+      switch (maxLength) {
+          case 32: processVoices(voicesOf<32>(), args); break;
+          case 64: processVoices(voicesOf<64>(), args); break;
+          default: processVoices(voicesOf<128>(), args); break;
+      }
+    }
+
+    // Resto de process() con las voces activas, de N pasos
+    template <unsigned int N>
+    void processVoices(Voices<N>& voices, const ProcessArgs& args) {
+      typedef VoiceT<N> Voice;
+
+      applyVoiceRequests(voices);
+
         // Procesamiento del botón de sync al inicio
       if (syncTrigger.process(params[SYNC_PARAM].getValue())) {
+        if (syncMode != SYNC_NOW) {
+          // En cola: se aplica en la próxima frontera (ver advanceMaster)
+          syncQueued = true;
+        } else {
          // Cuando se presiona el botón, resetear todas las voces
+          syncQueued = false;
+          masterStep = 0;
+          masterRestart = false;
           for (auto& voice : voices) {
              voice.currentStep = 0;  // Establecer directamente en 0 en lugar de par_l + par_p
              voice.reset();
              resetVoice(voice);
+             rollProbabilities(voice, &voice - &voices[0]);
 
              // Verificar si hay un hit en el primer paso y emitir el pulso
-             if (voice.sequence[0]) {  // Si hay un hit en el primer paso
+             if (voice.hitAt(0)) {  // Si hay un hit en el primer paso
                  voice.gatePulse.trigger(1e-3f);  // Trigger del pulso
                  if (gateMode == GATE_MODE) {
                      voice.gateOn = true;
                  }
                  
                  // Si hay acento en el primer paso, también triggerear el acento
-                 if (voice.accents[0]) {
+                 if (voice.accentAt(0)) {
                      voice.accentPulse.trigger(1e-3f);
                      if (gateMode == GATE_MODE) {
                             voice.accOn = true;
@@ -508,6 +1870,7 @@ struct Puya : Module {
                }
            }
         }
+      }
         // Obtener y validar voz actual para UI
       int newVoice = clamp(static_cast<int>(params[VOICE_PARAM].getValue()) - 1, 
                          0, NUM_VOICES_MAX - 1);
@@ -519,85 +1882,1094 @@ struct Puya : Module {
           loadVoiceState(voices[currentVoice]);
       }
   
-      // Procesar cada voz independientemente
-      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+      if (routingDirty) {
+          updateRouting();
+      }
+
+      // Procesar cada voz en orden de dependencia: una voz en cascada ve
+      // los eventos de su fuente en la misma muestra, sin latencia
+      bool scanParams = paramDivider.process();
+      bool anyStep = false;
+      bool analysis = outputs[ANALYSIS_OUTPUT].isConnected();
+      PuyaBusMessage* bus = rightExpander.module ? static_cast<PuyaBusMessage*>(rightExpander.producerMessage) : nullptr;
+
+      if (scanParams && inputs[BANK_INPUT].isConnected()) {
+          processSnapshotInput(voices);
+      }
+      for (int v : voiceOrder) {
           Voice& voice = voices[v];
           bool isCurrentVoice = (v == currentVoice);
+          voice.stepEvent = false;
+          voice.hitEvent = false;
+          voice.accentEvent = false;
+          voice.gridEvent = false;
+          voice.gridHit = false;
+
+          if (voice.morphing) {
+              processMorph(voice, v);
+          }
   
           // Procesar reset para esta voz específica
           if (inputs[RESET_INPUT].isConnected()) {
               if (voice.resetTrigger.process(inputs[RESET_INPUT].getVoltage(v))) {
-                  voice.currentStep = voice.par_l + voice.par_p;
-                  voice.reset();  // Asegurar reset completo
+                  resetPlayback(voice, v);
+                  anyStep = true;
               }
           }
   
+          // Disparo retrasado por swing o microtiming
+          if (voice.delayCountdown > 0 && --voice.delayCountdown == 0) {
+              fireStep(voice, v, voice.delayedStep);
+          }
+
           // Procesar clock para esta voz específica
           bool nextStep = false;
-          if (inputs[CLK_INPUT].isConnected()) {
-              if (voice.clockTrigger.process(inputs[CLK_INPUT].getVoltage(v))) {
-                  nextStep = true;
+          voice.clockSamples++;
+          if (voice.clockSource == Voice::CLOCK_MASTER) {
+              bool beat = false;
+              voice.beatSamples++;
+              if (inputs[CLK_INPUT].isConnected()) {
+                  float clockIn = inputs[CLK_INPUT].getVoltage(v);
+                  beat = voice.clockTrigger.process(clockIn);
+                  if (beat) {
+                      // Muestras transcurridas desde el cruce del umbral de 1V
+                      voice.edgeDelta = clamp((clockIn - 1.0f) / (clockIn - voice.lastClockIn), 0.0f, 0.999f);
+                  }
+                  voice.lastClockIn = clockIn;
+              }
+              if (beat) {
+                  // El ciclo maestro sólo avanza con los flancos de la voz de
+                  // referencia, aunque otras voces vean el reloj en otra muestra
+                  if (v == masterVoice) {
+                      stats.clockEdge(voice.beatSamples, voice.beatPeriod);
+                      advanceMaster(voice);
+                  }
+                  voice.beatPeriod = voice.beatSamples;
+                  voice.beatSamples = 0;
               }
+              nextStep = processRatio(voice, v, beat);
+          } else {
+              const Voice& source = voices[voice.clockVoice];
+              nextStep = (voice.clockSource == Voice::CLOCK_HITS) ? source.hitEvent : source.accentEvent;
+              voice.edgeDelta = source.edgeDelta;
+          }
+          if (nextStep) {
+              voice.clockPeriod = voice.clockSamples;
+              voice.clockSamples = 0;
           }
   
           if (nextStep) {
-              processStep(voice);
+              if (voice.resyncPending) {
+                  // El paso de ahora pasa a ser el 0, sin regenerar
+                  voice.resyncPending = false;
+                  voice.currentStep = voice.par_l + voice.par_p;
+              }
+              processStep(voice, v);
+              anyStep = true;
               
               // Actualizar salidas de clock
               outputs[CLK_OUTPUT].setVoltage(10.0f, v);
           } else {
               outputs[CLK_OUTPUT].setVoltage(0.0f, v);
           }
+
+          // Ratchets pendientes: cuenta atrás en muestras
+          if (voice.ratchetRemaining > 0 && --voice.ratchetCountdown == 0) {
+              fireRatchet(voice);
+          }
+
+          // Fin de las compuertas con duración
+          if (voice.gateCountdown > 0 && --voice.gateCountdown == 0) {
+              voice.gateOn = false;
+          }
+          if (voice.accentCountdown > 0 && --voice.accentCountdown == 0) {
+              voice.accOn = false;
+          }
   
-          // Procesar pulsos específicos de esta voz
-          bool gpulse = voice.gatePulse.process(1.0f / args.sampleRate);
-          bool apulse = voice.accentPulse.process(1.0f / args.sampleRate);
-  
-          // Configurar salidas específicas para esta voz
-          if (gateMode == TURING_MODE) {
-              float turingVoltage = 10.0f * (voice.turing / std::pow(2.0f, voice.par_l) - 1.0f);
-              outputs[GATE_OUTPUT].setVoltage(turingVoltage, v);
+          if (gateMode == AUDIO_MODE) {
+              processAudioVoice(voice, v, nextStep);
           } else {
-              float gateVoltage = (voice.gateOn || gpulse) ? 10.0f : 0.0f;
-              outputs[GATE_OUTPUT].setVoltage(gateVoltage, v);
+              // Procesar pulsos específicos de esta voz
+              bool gpulse = voice.gatePulse.process(args.sampleTime);
+              bool apulse = voice.accentPulse.process(args.sampleTime);
+              voice.gateHigh = voice.gateOn || gpulse;
+              voice.accentHigh = voice.accOn || apulse;
+
+              // Configurar salidas específicas para esta voz
+              if (gateMode == TURING_MODE) {
+                  float turingVoltage = 10.0f * (voice.turing / std::pow(2.0f, std::min(voice.par_l, TURING_BITS)) - 1.0f);
+                  outputs[GATE_OUTPUT].setVoltage(turingVoltage, v);
+              } else {
+                  outputs[GATE_OUTPUT].setVoltage(voice.gateHigh ? 10.0f : 0.0f, v);
+              }
+              outputs[ACCENT_OUTPUT].setVoltage(voice.accentHigh ? 10.0f : 0.0f, v);
           }
-          
-          float accentVoltage = (voice.accOn || apulse) ? 10.0f : 0.0f;
-          outputs[ACCENT_OUTPUT].setVoltage(accentVoltage, v);
   
-          // Solo actualizar parámetros para la voz actual en UI
-          if (isCurrentVoice) {
+          // Solo actualizar parámetros para la voz actual en UI; las voces
+          // en modo banco siguen además su CV de entrada
+          if (isCurrentVoice && scanParams) {
               updateVoiceParameters(voice);
+          } else if (voice.patternBank && scanParams) {
+              applyPositions(voice);
+          }
+
+          if (bus) {
+              publishVoice(bus->voices[v], voice, nextStep);
           }
       }
-  
+
+      if (analysis) {
+          processAnalysis(voices, anyStep);
+      }
+      outputs[MASTER_END_OUTPUT].setVoltage(masterEndPulse.process(args.sampleTime) ? 10.0f : 0.0f);
+
+      // Salidas compuestas a partir de los pasos tocados en esta muestra
+      if (outputs[COMPOSITE_OUTPUT].isConnected()) {
+          processComposites(voices, args);
+      }
+
       // Asegurar que todas las salidas mantengan su configuración polifónica
-      for (int i = 0; i < NUM_OUTPUTS; i++) {
+      for (int i = 0; i < ANALYSIS_OUTPUT; i++) {
           outputs[i].setChannels(NUM_VOICES_MAX);
       }
+      outputs[ANALYSIS_OUTPUT].setChannels(NUM_ANALYSIS * NUM_VOICES_MAX);
+      outputs[MASTER_PHASE_OUTPUT].setChannels(1);
+      outputs[MASTER_END_OUTPUT].setChannels(1);
+
+      if (bus) {
+          for (int o = 0; o < PuyaBusMessage::NUM_OUTPUTS; o++) {
+              copyPort(outputs[COMPOSITE_OUTPUT + o], bus->outputs[o]);
+          }
+          bus->maxLength = maxLength;
+          bus->frame = args.frame;
+          rightExpander.requestMessageFlip();
+      }
 
-      updateLights(args);
+      if (lightDivider.process()) {
+          updateLights(voices[currentVoice], args);
+      }
     }
 
-  void processStep(Voice& voice) {
+  // Puertos del expansor de la derecha: copia sus entradas en las de Puya
+  // y desconecta las salidas que allí no tienen cable. Sin expansor estos
+  // puertos quedan desconectados; la reproducción de trazas, que nunca
+  // tiene expansor, los escribe directamente.
+  void readExpander() {
+      Module* m = rightExpander.module;
+      const PuyaExpanderMessage* msg = nullptr;
+      if (m && m->model == modelPuyaExpander) {
+          msg = static_cast<const PuyaExpanderMessage*>(m->leftExpander.consumerMessage);
+          if (msg->version != PuyaExpanderMessage::VERSION) msg = nullptr;
+      }
+      if (!msg && !expanderAttached) return;
+      expanderAttached = (msg != nullptr);
+
+      for (int i = 0; i < PuyaExpanderMessage::NUM_INPUTS; i++) {
+          Input& input = inputs[RATCHET_INPUT + i];
+          if (msg) {
+              input.channels = msg->inputs[i].channels;
+              std::memcpy(input.voltages, msg->inputs[i].voltages, sizeof(msg->inputs[i].voltages));
+          } else {
+              input.channels = 0;
+              std::fill(input.voltages, input.voltages + PuyaBusPort::MAX_CHANNELS, 0.0f);
+          }
+      }
+      for (int o = 0; o < PuyaExpanderMessage::NUM_OUTPUTS; o++) {
+          Output& output = outputs[COMPOSITE_OUTPUT + o];
+          if (!msg || !msg->outputsConnected[o]) {
+              output.channels = 0;
+          } else if (output.channels == 0) {
+              output.channels = 1;
+          }
+      }
+  }
+
+  static void copyPort(const Port& from, PuyaBusPort& to) {
+      to.channels = static_cast<uint8_t>(from.channels);
+      std::memcpy(to.voltages, from.voltages, sizeof(to.voltages));
+  }
+
+  // Salida de análisis. Las métricas del patrón se recalculan sólo tras una
+  // regeneración y la fase sólo cuando alguna voz avanza; entre tanto los
+  // canales conservan su voltaje y no cuestan nada por muestra.
+  template <unsigned int N>
+  void processAnalysis(Voices<N>& voices, bool anyStep) {
+      typedef VoiceT<N> Voice;
+      bool regenerated = false;
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          Voice& voice = voices[v];
+          if (!voice.analysisDirty) continue;
+          voice.analyze();
+          outputs[ANALYSIS_OUTPUT].setVoltage(10.0f * voice.density, v);
+          outputs[ANALYSIS_OUTPUT].setVoltage(10.0f * voice.evenness, NUM_VOICES_MAX + v);
+          outputs[ANALYSIS_OUTPUT].setVoltage(10.0f * voice.syncopation, 2 * NUM_VOICES_MAX + v);
+          regenerated = true;
+      }
+      if (!anyStep && !regenerated) return;
+      updateMasterCycle(voices);
+
+      // Fase: posición de la voz dentro del ciclo maestro, contando los
+      // ciclos completos que lleva desde el reset
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          const Voice& voice = voices[v];
+          uint32_t length = std::max(1u, voice.par_l + voice.par_p);
+          uint64_t steps = static_cast<uint64_t>(voice.cycleCount) * length + std::min(voice.currentStep, length - 1);
+          uint64_t beats = steps * voice.ratioQ / voice.ratioP;
+          outputs[ANALYSIS_OUTPUT].setVoltage(10.0f * (beats % masterCycle) / masterCycle, 3 * NUM_VOICES_MAX + v);
+      }
+  }
+
+  // Ciclo maestro, en pulsos: mcm de los ciclos de las voces con reloj
+  // maestro (las voces en cascada no avanzan con él). Sólo se recalcula
+  // cuando alguna longitud, relación o fuente de reloj cambió.
+  template <unsigned int N>
+  void updateMasterCycle(const Voices<N>& voices) {
+      typedef VoiceT<N> Voice;
+      bool changed = false;
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          const Voice& voice = voices[v];
+          uint32_t length = (voice.clockSource == Voice::CLOCK_MASTER) ? cycleBeats(voice) : 1u;
+          if (length != masterLengths[v]) {
+              masterLengths[v] = length;
+              changed = true;
+          }
+      }
+      if (changed) {
+          masterCycle = 1;
+          for (uint32_t length : masterLengths) {
+              masterCycle = lcm(masterCycle, length);
+          }
+      }
+  }
+
+  // Pulso de reloj de la voz de referencia (masterVoice): avanza la
+  // posición en el ciclo maestro y, si toca, aplica la sincronización
+  // pendiente. Esa voz es también la referencia del tiempo fuerte. Con
+  // canales de reloj desfasados, los pulsos de las demás voces no mueven
+  // el ciclo.
+  template <typename Voice>
+  void advanceMaster(const Voice& reference) {
+      Voices<Voice::WIDTH>& voices = voicesOf<Voice::WIDTH>();
+      updateMasterCycle(voices);
+      uint32_t next = masterRestart ? 0 : (masterStep + 1) % masterCycle;
+      if (syncQueued) {
+          bool boundary = (syncMode == SYNC_ON_MASTER)
+              ? next == 0
+              : reference.currentStep + 1 >= reference.par_l + reference.par_p;
+          if (boundary) {
+              // Cada voz vuelve al paso 0 en su próximo paso; sin regenerar
+              for (auto& voice : voices) {
+                  voice.resyncPending = true;
+              }
+              syncQueued = false;
+              next = 0;
+          }
+      }
+      masterRestart = false;
+      masterStep = next;
+      if (next == 0) {
+          masterEndPulse.trigger(1e-3f);
+      }
+      outputs[MASTER_PHASE_OUTPUT].setVoltage(10.0f * next / masterCycle);
+  }
+
+  static uint32_t gcd(uint32_t x, uint32_t y) {
+      while (y) {
+          uint32_t t = x % y;
+          x = y;
+          y = t;
+      }
+      return x;
+  }
+
+  static uint32_t lcm(uint32_t a, uint32_t b) {
+      return a / gcd(a, b) * b;
+  }
+
+  // Pulsos maestros que tarda una voz en repetir patrón y rejilla: el
+  // ciclo de L pasos con relación p:q vuelve a caer en el inicio de un
+  // grupo cada q*L/mcd(L,p) pulsos (L con 1:1)
+  static uint32_t cycleBeats(const VoiceBase& voice) {
+      uint32_t length = std::max(1u, voice.par_l + voice.par_p);
+      return voice.ratioQ * (length / gcd(length, voice.ratioP));
+  }
+
+  // Reloj maestro con relación p:q. En cada pulso se fija la relación
+  // (menú + RATIO_INPUT) y el rango de pasos del grupo que caen dentro de
+  // él; cada paso se dispara con una cuenta atrás desde el pulso. Los pasos
+  // que un pulso adelantado deja pendientes se descartan: la rejilla sale
+  // siempre del número de pulso, así que se recupera en el mismo pulso.
+  bool processRatio(VoiceBase& voice, int v, bool beat) {
+      if (beat) {
+          int index = voice.ratio;
+          if (inputs[RATIO_INPUT].isConnected()) {
+              index += static_cast<int>(std::round(getParameterizedVoltage(RATIO_INPUT, v)));
+          }
+          const StepRatio& r = STEP_RATIOS[clamp(index, 0, NUM_STEP_RATIOS - 1)];
+          if (r.p != voice.ratioP || r.q != voice.ratioQ || voice.ratioBeat < 0 || voice.resyncPending) {
+              // Relación nueva, reset o sincronización: el grupo empieza aquí
+              voice.ratioP = r.p;
+              voice.ratioQ = r.q;
+              voice.ratioBeat = 0;
+          } else if (++voice.ratioBeat >= voice.ratioQ) {
+              voice.ratioBeat = 0;
+          }
+
+          // Pasos j con b <= j*q/p < b+1
+          int b = voice.ratioBeat;
+          voice.ratioStep = (b * voice.ratioP + voice.ratioQ - 1) / voice.ratioQ;
+          voice.ratioEnd = ((b + 1) * voice.ratioP + voice.ratioQ - 1) / voice.ratioQ;
+          if (voice.beatPeriod == 0) {
+              // Sin periodo medido sólo se puede disparar sobre el pulso
+              voice.ratioEnd = std::min(voice.ratioEnd, voice.ratioStep + 1);
+          }
+          armRatio(voice);
+      }
+
+      if (voice.ratioStep >= voice.ratioEnd) return false;
+      if (voice.ratioCountdown > 0) {
+          voice.ratioCountdown--;
+          return false;
+      }
+      voice.ratioStep++;
+      armRatio(voice);
+      if (voice.ratioCountdown > 0) voice.ratioCountdown--;
+      if (!beat) voice.edgeDelta = 0.0f;
+      return true;
+  }
+
+  // Cuenta atrás hasta el paso ratioStep, que cae (j*q - b*p)/p pulsos
+  // después del pulso b del grupo
+  static void armRatio(VoiceBase& voice) {
+      if (voice.ratioStep >= voice.ratioEnd) return;
+      uint64_t offset = static_cast<uint64_t>(voice.ratioStep * voice.ratioQ - voice.ratioBeat * voice.ratioP)
+                      * voice.beatPeriod / voice.ratioP;
+      voice.ratioCountdown = (offset > voice.beatSamples) ? static_cast<uint32_t>(offset - voice.beatSamples) : 0;
+  }
+
+  // Hilo de la interfaz: abre un banco de patrones (vacío = quitarlo). Las
+  // voces en modo banco vuelven a pedir su entrada al nuevo archivo.
+  bool loadPatternBank(const std::string& path) {
+      for (auto& slot : bankSlots) {
+          slot.publish(-1, PatternEntry());
+      }
+      bool ok = !path.empty() && patternFile.open(path);
+      if (!ok) {
+          patternFile.close();
+      }
+      bankSize.store(ok ? static_cast<uint32_t>(patternFile.size()) : 0, std::memory_order_relaxed);
+      bankGeneration.store(bankGeneration.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+      return ok;
+  }
+
+  // Hilo de la interfaz: interpreta y publica las entradas pedidas
+  void servicePatternBank() {
+      if (!patternFile.isOpen()) return;
+      for (auto& slot : bankSlots) {
+          int32_t wanted = slot.requested.load(std::memory_order_acquire);
+          if (wanted < 0 || wanted == slot.published()) continue;
+          const PatternEntry* entry = patternFile.entry(wanted);
+          if (entry) {
+              slot.publish(wanted, *entry);
+          }
+      }
+  }
+
+  // Entrada del banco para una posición de K (0-1) más PATTERN_INPUT; se
+  // pide a la interfaz y se carga en el próximo inicio de ciclo
+  void selectBankEntry(VoiceBase& voice, int v, float x) {
+      uint32_t generation = bankGeneration.load(std::memory_order_acquire);
+      if (generation != voice.bankGeneration) {
+          voice.bankGeneration = generation;
+          voice.bankEntry = -1;
+      }
+      uint32_t size = bankSize.load(std::memory_order_relaxed);
+      if (size == 0) {
+          voice.bankWanted = -1;
+          return;
+      }
+      if (inputs[PATTERN_INPUT].isConnected()) {
+          x += getParameterizedVoltage(PATTERN_INPUT, v) * 0.1f;
+      }
+      int32_t index = static_cast<int32_t>(clamp(x, 0.0f, 1.0f) * size);
+      voice.bankWanted = std::min(index, static_cast<int32_t>(size) - 1);
+      bankSlots[v].requested.store(voice.bankWanted, std::memory_order_release);
+  }
+
+  // Copia la entrada publicada en el patrón de la voz, sin regenerar. Las
+  // entradas vacías o más largas que maxLength se marcan como cargadas
+  // pero dejan el patrón como estaba.
+  template <typename Voice>
+  bool loadBankEntry(Voice& voice, int v, int32_t index) {
+      typedef typename Voice::Engine::Mask Mask;
+      typedef typename Mask::word_t word_t;
+      PatternEntry entry;
+      if (index < 0 || !bankSlots[v].read(index, entry)) return false;
+      voice.bankEntry = index;
+      if (entry.length == 0 || entry.length > maxLength) return false;
+
+      for (unsigned int i = 0; i < Mask::NUM_WORDS; i++) {
+          voice.sequence.setWord(i, static_cast<word_t>(entry.sequence[i]));
+          voice.accents.setWord(i, static_cast<word_t>(entry.accents[i] & entry.sequence[i]));
+      }
+      voice.setLiteral(entry.length, maxLength);
+      return true;
+  }
+
+  // Activa o desactiva el modo banco; al salir la voz vuelve a sus perillas
+  // y deja de conservar la última entrada (hilo de audio, ver
+  // requestPatternBank)
+  template <typename Voice>
+  void setPatternBank(Voice& voice, bool patternBank) {
+      voice.patternBank = patternBank;
+      voice.bankEntry = -1;
+      if (!patternBank) {
+          voice.literal = false;
+      }
+      if (!voice.positionsValid) {
+          positionsFromParameters(voice);
+      }
+      if (patternBank) {
+          applyPositions(voice);
+      } else {
+          mapPositions(voice);
+          voice.calculate = true;
+          resetVoice(voice);
+      }
+  }
+
+  // Interfaz: pide activar o desactivar el modo banco de la voz v
+  void requestPatternBank(int v, bool patternBank) {
+      voiceRequests[v].patternBank = patternBank ? 1 : 0;
+  }
+
+  // Grabación de la traza: el estado del módulo va en la cabecera y las
+  // entradas y parámetros, muestra a muestra, en los eventos
+  bool startTrace(const std::string& path, float sampleRate) {
+      std::string state;
+      json_t* rootJ = dataToJson();
+      if (rootJ) {
+          char* text = json_dumps(rootJ, JSON_COMPACT);
+          if (text) state = text;
+          std::free(text);
+          json_decref(rootJ);
+      }
+      return trace.start(path, sampleRate, state);
+  }
+
+  void recordTraceFrame() {
+      for (int i = 0; i < NUM_INPUTS; i++) {
+          int id = i * TRACE_CHANNELS;
+          for (int c = 0; c < NUM_VOICES_MAX; c++) {
+              trace.signal(id + c, inputs[i].getVoltage(c));
+          }
+          trace.signal(id + NUM_VOICES_MAX, inputs[i].getChannels());
+      }
+      for (int p = 0; p < NUM_PARAMS; p++) {
+          trace.signal(NUM_INPUTS * TRACE_CHANNELS + p, params[p].getValue());
+      }
+      trace.endFrame();
+  }
+
+  void applyTraceSignal(unsigned int id, float value) {
+      if (id < NUM_INPUTS * TRACE_CHANNELS) {
+          Input& input = inputs[id / TRACE_CHANNELS];
+          unsigned int c = id % TRACE_CHANNELS;
+          if (c == NUM_VOICES_MAX) input.channels = static_cast<uint8_t>(value);
+          else input.setVoltage(value, c);
+      } else {
+          params[id - NUM_INPUTS * TRACE_CHANNELS].setValue(value);
+      }
+  }
+
+  // Reproduce una traza lo más rápido posible en un Puya nuevo, sin motor
+  // ni interfaz: cronometra cada process() y resume todas las salidas en
+  // un hash, que sólo cambia si cambia el comportamiento. El generador
+  // global de Rack se siembra fijo para que el estilo aleatorio también
+  // se repita.
+  static bool replayTrace(const std::string& path, ReplayResult& result, const std::atomic<bool>& abort) {
+      PuyaTraceReader reader;
+      if (!reader.open(path) || reader.numSignals != NUM_TRACE_SIGNALS || reader.sampleRate <= 0.0f) {
+          return false;
+      }
+      random::local().seed(0x5075796154726163ull, 1);
+
+      std::unique_ptr<Puya> puya(new Puya());
+      json_error_t error;
+      json_t* rootJ = reader.state.empty() ? nullptr : json_loads(reader.state.c_str(), 0, &error);
+      if (rootJ) {
+          puya->dataFromJson(rootJ);
+          json_decref(rootJ);
+      }
+      for (Input& input : puya->inputs) {
+          input.channels = 0;
+      }
+
+      ProcessArgs args;
+      args.sampleRate = reader.sampleRate;
+      args.sampleTime = 1.0f / reader.sampleRate;
+      args.frame = 0;
+
+      uint64_t hash = 0xcbf29ce484222325ull;
+      double totalNanos = 0.0;
+      uint64_t frame = 0;
+      unsigned int id = 0;
+      float value = 0.0f;
+      bool more = reader.next(frame, id, value);
+      result = ReplayResult();
+      result.path = path;
+      result.sampleRate = reader.sampleRate;
+
+      PuyaStats::Clock::time_point start = PuyaStats::Clock::now();
+      for (uint64_t f = 0; more || f < reader.end(); f++) {
+          while (more && frame == f) {
+              puya->applyTraceSignal(id, value);
+              more = reader.next(frame, id, value);
+          }
+          if (!more && f >= reader.end()) break;
+          if ((f & 4095) == 0 && abort.load(std::memory_order_relaxed)) return false;
+
+          // Sin widget: el banco se atiende aquí, fuera del tiempo medido
+          puya->servicePatternBank();
+
+          args.frame = static_cast<int64_t>(f);
+          PuyaStats::Clock::time_point t0 = PuyaStats::Clock::now();
+          puya->process(args);
+          double ns = std::chrono::duration<double, std::nano>(PuyaStats::Clock::now() - t0).count();
+          totalNanos += ns;
+          if (ns > result.maxNanos) {
+              result.maxNanos = ns;
+              result.maxFrame = f;
+          }
+
+          for (Output& output : puya->outputs) {
+              for (int c = 0; c < output.getChannels(); c++) {
+                  float v = output.getVoltage(c);
+                  uint32_t bits;
+                  std::memcpy(&bits, &v, sizeof(bits));
+                  for (int b = 0; b < 4; b++) {
+                      hash = (hash ^ ((bits >> (8 * b)) & 0xFF)) * 0x100000001b3ull;
+                  }
+              }
+          }
+          result.frames++;
+      }
+
+      result.wallSeconds = std::chrono::duration<double>(PuyaStats::Clock::now() - start).count();
+      result.seconds = result.frames / static_cast<double>(reader.sampleRate);
+      result.averageNanos = result.frames ? totalNanos / result.frames : 0.0;
+      PuyaStats::Snapshot stats = puya->stats.snapshot();
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          result.regenerations += stats.voiceRegenerations(v);
+      }
+      result.hash = hash;
+      result.valid = true;
+      return true;
+  }
+
+  // Interfaz: lanza la reproducción si no hay otra en curso
+  bool startReplay(const std::string& path) {
+      if (replayBusy.load(std::memory_order_acquire)) return false;
+      if (replayThread.joinable()) replayThread.join();
+      replayBusy.store(true, std::memory_order_relaxed);
+      replayThread = std::thread([this, path]() {
+          random::init();
+          ReplayResult result;
+          if (replayTrace(path, result, replayAbort)) {
+              INFO("Puya: traza %s, %llu muestras (%.1f s) en %.2f s (x%.1f), process() media %.0f ns, "
+                   "máx %.0f ns en la muestra %llu, regeneraciones %llu, hash %016llx",
+                   path.c_str(), static_cast<unsigned long long>(result.frames), result.seconds,
+                   result.wallSeconds, result.seconds / std::max(result.wallSeconds, 1e-9),
+                   result.averageNanos, result.maxNanos, static_cast<unsigned long long>(result.maxFrame),
+                   static_cast<unsigned long long>(result.regenerations), static_cast<unsigned long long>(result.hash));
+          } else {
+              WARN("Puya: no se pudo reproducir la traza %s", path.c_str());
+          }
+          replayResult = result;
+          replayBusy.store(false, std::memory_order_release);
+      });
+      return true;
+  }
+
+  // Estilos deterministas para el índice inverso: mismos seq0/acc0 que
+  // resetVoice (el aleatorio y Cantor no tienen índice)
+  static void euclideanSteps(unsigned int l, unsigned int k, unsigned int a,
+                             std::vector<bool>& seq0, std::vector<bool>& acc0) {
+      Bjorklund euclid, euclid2;
+      PatternEngine<MAX_SEQUENCE_LEN>::euclidean(l, k, a, euclid, euclid2, seq0, acc0);
+  }
+
+  static PatternIndex::Generator indexGenerator(patternStyle style) {
+      switch (style) {
+          case EUCLIDEAN_PATTERN: return euclideanSteps;
+          case FIBONACCI_PATTERN: return PatternEngine<MAX_SEQUENCE_LEN>::fibonacci;
+          case LINEAR_PATTERN: return PatternEngine<MAX_SEQUENCE_LEN>::linear;
+          default: return nullptr;
+      }
+  }
+
+  // Índice de un estilo y ancho. Lo construye un hilo aparte (a 128 pasos
+  // tarda del orden de 200 ms); ready lo publica a la interfaz.
+  struct PatternIndexSlot {
+      std::unique_ptr<PatternIndex> index;
+      std::atomic<bool> ready{false};
+      std::thread builder;
+
+      ~PatternIndexSlot() {
+          if (builder.joinable()) builder.join();
+      }
+  };
+
+  // Índice del estilo para la longitud máxima, compartido por todas las
+  // instancias. La primera petición lanza su construcción; hasta que está
+  // listo devuelve nullptr (ver patternIndexPending). Hilo de la interfaz.
+  static const PatternIndex* patternIndex(patternStyle style, unsigned int maxLength) {
+      static PatternIndexSlot slots[CANTOR_PATTERN + 1][3];
+      PatternIndex::Generator generator = indexGenerator(style);
+      if (!generator) return nullptr;
+      int size = (maxLength <= 32) ? 0 : (maxLength <= 64) ? 1 : 2;
+      PatternIndexSlot& slot = slots[style][size];
+      if (slot.ready.load(std::memory_order_acquire)) {
+          return slot.index.get();
+      }
+      if (!slot.builder.joinable()) {
+          unsigned int length = (size == 0) ? 32 : (size == 1) ? 64 : 128;
+          slot.builder = std::thread([&slot, generator, length]() {
+              slot.index.reset(new PatternIndex(generator, length));
+              slot.ready.store(true, std::memory_order_release);
+          });
+      }
+      return nullptr;
+  }
+
+  // El estilo tiene índice pero todavía se está construyendo
+  bool patternIndexPending() const {
+      return indexGenerator(style) && !patternIndex(style, maxLength);
+  }
+
+  // Parámetros de la voz que reproducen un ritmo escrito ("x..x.X..",
+  // mismo formato que los bancos), o los más cercanos
+  PatternIndex::Match findParameters(const std::string& text) const {
+      PatternIndex::Match match;
+      const PatternIndex* index = patternIndex(style, maxLength);
+      if (!index) return match;
+
+      PatternEntry entry;
+      const char* p = text.c_str();
+      const char* end = p + text.size();
+      while (p < end && (*p == ' ' || *p == '\t')) p++;
+      entry.parse(p, end);
+
+      PatternIndex::Bits hits, accents;
+      hits.lo = entry.sequence[0];
+      hits.hi = entry.sequence[1];
+      accents.lo = entry.accents[0];
+      accents.hi = entry.accents[1];
+      return index->find(hits, accents, entry.length);
+  }
+
+  // Aplica el resultado de findParameters y mueve las perillas si la voz
+  // es la seleccionada (hilo de audio, ver requestParameters)
+  template <typename Voice>
+  void applyParameters(Voice& voice, const PatternIndex::Match& match) {
+      if (!match.found || voice.catalog || voice.patternBank || voice.morphing) return;
+      voice.par_l = match.l;
+      voice.par_p = match.p;
+      voice.par_r = match.r;
+      voice.par_k = match.k;
+      voice.par_a = match.a;
+      voice.par_s = match.s;
+      voice.literal = false;
+      voice.clampParameters(maxLength);
+      positionsFromParameters(voice);
+      voice.calculate = true;
+      resetVoice(voice);
+      voice.par_last = voice.par_k + voice.par_l + voice.par_r + voice.par_p + voice.par_s + voice.par_a;
+      if (&voice == &voicesOf<Voice::WIDTH>()[currentVoice]) {
+          loadVoiceState(voice);
+      }
+  }
+
+  // Un byte por parámetro (ninguno pasa de 128) y el bit 48 de petición
+  static uint64_t packMatch(const PatternIndex::Match& match) {
+      if (!match.found) return 0;
+      return (1ull << 48) | (uint64_t(match.l) << 40) | (uint64_t(match.k) << 32)
+          | (uint64_t(match.r) << 24) | (uint64_t(match.p) << 16)
+          | (uint64_t(match.a) << 8) | uint64_t(match.s);
+  }
+
+  static PatternIndex::Match unpackMatch(uint64_t packed) {
+      PatternIndex::Match match;
+      match.found = (packed >> 48) & 1;
+      match.l = (packed >> 40) & 0xff;
+      match.k = (packed >> 32) & 0xff;
+      match.r = (packed >> 24) & 0xff;
+      match.p = (packed >> 16) & 0xff;
+      match.a = (packed >> 8) & 0xff;
+      match.s = packed & 0xff;
+      return match;
+  }
+
+  // Interfaz: pide aplicar el resultado de findParameters a la voz v
+  void requestParameters(int v, const PatternIndex::Match& match) {
+      uint64_t packed = packMatch(match);
+      if (packed) {
+          voiceRequests[v].parameters = packed;
+      }
+  }
+
+  // Aplica las peticiones del menú a las voces activas (hilo de audio)
+  template <unsigned int N>
+  void applyVoiceRequests(Voices<N>& voices) {
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          VoiceRequests& requests = voiceRequests[v];
+          int catalog = requests.catalog.exchange(-1);
+          if (catalog >= 0) {
+              setCatalog(voices[v], catalog != 0);
+          }
+          int patternBank = requests.patternBank.exchange(-1);
+          if (patternBank >= 0) {
+              setPatternBank(voices[v], patternBank != 0);
+          }
+          uint64_t parameters = requests.parameters.exchange(0);
+          if (parameters) {
+              applyParameters(voices[v], unpackMatch(parameters));
+          }
+      }
+  }
+
+  // Reset de una voz: sólo reposiciona la reproducción, sin borrar ni
+  // regenerar el patrón. Se procesa antes que el reloj de la misma muestra,
+  // así que un pulso simultáneo o posterior toca el paso 0. Si el pulso
+  // llegó hasta resetWindow muestras antes, el reset se considera
+  // simultáneo: el paso recién tocado se repite como paso 0. Si ese paso ya
+  // era el 0, la posición se conserva (sin volver a dispararlo) y sólo se
+  // realinean el grupo p:q y el ciclo maestro.
+  template <typename Voice>
+  void resetPlayback(Voice& voice, int v) {
+      uint32_t length = voice.par_l + voice.par_p;
+      uint32_t since = (voice.clockSource == Voice::CLOCK_MASTER) ? voice.beatSamples : voice.clockSamples;
+      bool inWindow = since < resetWindow && voice.currentStep < length;
+      bool late = inWindow && voice.currentStep != 0;
+      if (!inWindow || late) {
+          voice.rewind();
+          if (voice.clockSource == Voice::CLOCK_MASTER) {
+              masterRestart = true;
+          }
+      }
+      if (!inWindow) return;
+
+      if (voice.clockSource == Voice::CLOCK_MASTER) {
+          // El pulso pasa a ser el primero del grupo p:q y del ciclo maestro
+          voice.ratioBeat = 0;
+          voice.ratioStep = 1;
+          voice.ratioEnd = (voice.ratioP + voice.ratioQ - 1) / voice.ratioQ;
+          armRatio(voice);
+          if (voice.ratioCountdown > 0) voice.ratioCountdown--;
+          masterRestart = false;
+          masterStep = 0;
+          masterEndPulse.trigger(1e-3f);
+          outputs[MASTER_PHASE_OUTPUT].setVoltage(0.0f);
+      }
+      if (late) {
+          processStep(voice, v);
+      }
+  }
+
+  template <typename Voice>
+  void mutateVoice(Voice& voice, int v) {
+      float p = clamp(voice.mutationAmount + getParameterizedVoltage(MUTATE_INPUT, v) * 0.1f, 0.0f, 1.0f);
+      voice.mutate(p, voice.par_l + voice.par_p, voice.mutationKeepHits, random::u64);
+  }
+
+  // Morph: la posición (menú + MORPH_INPUT) sólo indexa el camino; el
+  // camino se recalcula aquí cuando cambia un extremo
+  template <typename Voice>
+  void processMorph(Voice& voice, int v) {
+      if (voice.morphDirty) {
+          buildMorphPath(voice);
+          if (!voice.morphing) return;
+      }
+
+      float x = clamp(voice.morphAmount + getParameterizedVoltage(MORPH_INPUT, v) * 0.1f, 0.0f, 1.0f);
+      int node = static_cast<int>(voice.morphPath.index(x));
+      if (node != voice.morphNode) {
+          voice.morphNode = node;
+          voice.applyMorphNode(voice.morphPath.nodes[node], maxLength);
+      }
+  }
+
+  template <typename Voice>
+  void buildMorphPath(Voice& voice) {
+      voice.morphDirty = false;
+      voice.morphNode = -1;
+      unsigned int lengthA = voice.morphA.par_l + voice.morphA.par_p;
+      unsigned int lengthB = voice.morphB.par_l + voice.morphB.par_p;
+      if (!voice.canMorph() || lengthA > maxLength || lengthB > maxLength) {
+          voice.morphing = false;
+          return;
+      }
+      voice.morphPath.build(voice.morphA.sequence, voice.morphA.accents, lengthA,
+                            voice.morphB.sequence, voice.morphB.accents, lengthB);
+  }
+
+  // Fija un extremo del morph con el patrón actual de la voz
+  template <typename Voice>
+  void setMorphEndpoint(Voice& voice, bool endpointB) {
+      if (endpointB) {
+          voice.capture(voice.morphB);
+          voice.morphBValid = true;
+      } else {
+          voice.capture(voice.morphA);
+          voice.morphAValid = true;
+      }
+      voice.morphDirty = true;
+  }
+
+  void setMorphEndpoint(int v, bool endpointB) {
+      switch (maxLength) {
+          case 32: setMorphEndpoint(voicesOf<32>()[v], endpointB); break;
+          case 64: setMorphEndpoint(voicesOf<64>()[v], endpointB); break;
+          default: setMorphEndpoint(voicesOf<128>()[v], endpointB); break;
+      }
+  }
+
+  // Al salir del morph la voz en edición vuelve a seguir las perillas
+  template <typename Voice>
+  void setMorphing(Voice& voice, int v, bool morphing) {
+      voice.morphing = morphing && voice.canMorph();
+      voice.morphNode = -1;
+      if (!voice.morphing) {
+          voice.literal = false;
+      }
+      if (!voice.morphing && v == currentVoice) {
+          voice.calculate = true;
+          saveVoiceState(voice);
+          resetVoice(voice);
+      }
+  }
+
+  void setMorphing(int v, bool morphing) {
+      switch (maxLength) {
+          case 32: setMorphing(voicesOf<32>()[v], v, morphing); break;
+          case 64: setMorphing(voicesOf<64>()[v], v, morphing); break;
+          default: setMorphing(voicesOf<128>()[v], v, morphing); break;
+      }
+  }
+
+  // Guarda el patrón actual de todas las voces en la ranura slot
+  void storeSnapshot(int slot) {
+      switch (maxLength) {
+          case 32: storeSnapshot(voicesOf<32>(), snapshots[slot]); break;
+          case 64: storeSnapshot(voicesOf<64>(), snapshots[slot]); break;
+          default: storeSnapshot(voicesOf<128>(), snapshots[slot]); break;
+      }
+  }
+
+  template <unsigned int N>
+  static void storeSnapshot(const Voices<N>& voices, Snapshot& snapshot) {
+      typename VoiceT<N>::State state;
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          voices[v].capture(state);
+          snapshot.voices[v].assign<N>(state);
+      }
+      snapshot.valid = true;
+  }
+
+  // Programa la ranura slot para el próximo inicio de ciclo de cada voz
+  void requestSnapshot(int slot) {
+      if (!snapshots[slot].valid) return;
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          activeVoice(v).pendingSnapshot = slot;
+      }
+  }
+
+  // Copia el patrón guardado; la voz en edición mueve también las perillas
+  template <typename Voice>
+  void recallSnapshot(Voice& voice, int v) {
+      const Snapshot& snapshot = snapshots[voice.pendingSnapshot];
+      voice.pendingSnapshot = -1;
+      if (!snapshot.valid || !snapshot.voices[v].fits(maxLength)) return;
+
+      typename Voice::State state;
+      state.template assign<MAX_SEQUENCE_LEN>(snapshot.voices[v]);
+      voice.restore(state);
+      if (v == currentVoice) {
+          loadVoiceState(voice);
+      }
+  }
+
+  // Entrada BANK: 0-10V recorre las ranuras; un cambio de ranura se
+  // aplica al próximo inicio de ciclo de la voz (canal por voz)
+  template <unsigned int N>
+  void processSnapshotInput(Voices<N>& voices) {
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          VoiceT<N>& voice = voices[v];
+          int slot = clamp(static_cast<int>(getParameterizedVoltage(BANK_INPUT, v) * 0.1f * NUM_SNAPSHOTS),
+                           0, NUM_SNAPSHOTS - 1);
+          if (slot != voice.snapshotSlot) {
+              voice.snapshotSlot = slot;
+              if (snapshots[slot].valid) {
+                  voice.pendingSnapshot = slot;
+              }
+          }
+      }
+  }
+
+  // Estado de la voz para el bus de expansión
+  template <typename Voice>
+  void publishVoice(PuyaBusMessage::Voice& out, const Voice& voice, bool stepped) {
+      PuyaBusMessage::pack(voice.sequence, out.sequence);
+      PuyaBusMessage::pack(voice.accents, out.accents);
+      PuyaBusMessage::pack(voice.hitGate, out.hitGate);
+      PuyaBusMessage::pack(voice.accentGate, out.accentGate);
+      out.length = voice.par_l + voice.par_p;
+      out.step = voice.currentStep;
+      out.clockPeriod = voice.clockPeriod;
+      out.stepped = stepped;
+      out.cycleStart = stepped && voice.currentStep == 0;
+      out.hit = voice.hitEvent;
+      out.accent = voice.accentEvent;
+      out.gate = voice.gateHigh;
+      out.accentGateOn = voice.accentHigh;
+  }
+
+  // Modo audio: el patrón como oscilador de pulsos. Cada hit sube la
+  // compuerta en el instante fraccional del flanco de reloj y la baja
+  // tras AUDIO_DUTY del periodo medido; los saltos son PolyBLEP (±5V).
+  void processAudioVoice(VoiceBase& voice, int v, bool stepped) {
+      if (voice.audioFall > 0.0f) {
+          voice.audioFall -= 1.0f;
+          if (voice.audioFall <= 0.0f) {
+              voice.audioGate.setLevel(-5.0f, -voice.audioFall);
+              voice.audioAccent.setLevel(-5.0f, -voice.audioFall);
+          }
+      }
+
+      if (stepped) {
+          float delta = voice.edgeDelta;
+          if (voice.hitEvent) {
+              voice.audioGate.setLevel(5.0f, delta);
+              voice.audioAccent.setLevel(voice.accentEvent ? 5.0f : -5.0f, delta);
+              voice.audioFall = std::max(AUDIO_DUTY * voice.clockPeriod - delta, 0.5f);
+          } else {
+              voice.audioGate.setLevel(-5.0f, delta);
+              voice.audioAccent.setLevel(-5.0f, delta);
+              voice.audioFall = 0.0f;
+          }
+      }
+
+      float gate = voice.audioGate.process();
+      float accent = voice.audioAccent.process();
+      voice.gateHigh = voice.audioGate.level > 0.0f;
+      voice.accentHigh = voice.audioAccent.level > 0.0f;
+      outputs[GATE_OUTPUT].setVoltage(gate, v);
+      outputs[ACCENT_OUTPUT].setVoltage(accent, v);
+  }
+
+  // Nuevo sorteo de la capa de probabilidad para el ciclo que empieza
+  template <typename Voice>
+  void rollProbabilities(Voice& voice, int v) {
+      float depth = 0.0f;
+      if (inputs[RND_INPUT].isConnected()) {
+          depth = clamp(inputs[RND_INPUT].getPolyVoltage(v) / 10.0f, 0.0f, 1.0f);
+      }
+      voice.rollProbabilities(depth, random::u64);
+  }
+
+  template <typename Voice>
+  void processStep(Voice& voice, int v) {
+      // Un disparo retrasado que no llegó a sonar sale antes del paso nuevo
+      if (voice.delayCountdown > 0) {
+          voice.delayCountdown = 0;
+          fireStep(voice, v, voice.delayedStep);
+      }
+
       // Actualizar paso actual
       voice.currentStep++;
       if (voice.currentStep >= voice.par_l + voice.par_p) {
           voice.currentStep = 0;
+          voice.cycleCount++;
+      }
+
+      // Aleatoriedad retenida hasta el siguiente flanco elegido
+      if (voice.randomSync == Voice::RANDOM_ON_STEP || voice.currentStep == 0) {
+          randomizeVoice(voice, v);
+      }
+
+      // Inicio de ciclo: entrada del banco, mutación, instantánea pendiente y
+      // sorteo de probabilidades
+      if (voice.currentStep == 0) {
+          if (voice.patternBank && voice.bankWanted != voice.bankEntry) {
+              loadBankEntry(voice, v, voice.bankWanted);
+          }
+          if (voice.mutating && !voice.mutationLocked) {
+              mutateVoice(voice, v);
+          }
+          if (voice.pendingSnapshot >= 0) {
+              recallSnapshot(voice, v);
+          }
+          rollProbabilities(voice, v);
+      }
+
+      // Las combinaciones lógicas leen la rejilla: un paso con swing o
+      // microtiming cuenta en la muestra en que avanza la voz
+      voice.gridEvent = true;
+      voice.gridHit = voice.hitAt(voice.currentStep);
+
+      // En modo audio las compuertas se generan en processAudioVoice
+      if (gateMode == AUDIO_MODE) {
+          voice.stepEvent = true;
+          voice.hitEvent = voice.hitAt(voice.currentStep);
+          voice.accentEvent = voice.accentAt(voice.currentStep);
+          return;
+      }
+
+      // Swing y microtiming: el paso suena tras una cuenta atrás
+      uint32_t delay = stepDelay(voice, voice.currentStep);
+      if (delay > 0) {
+          voice.delayCountdown = delay;
+          voice.delayedStep = voice.currentStep;
+          return;
+      }
+      fireStep(voice, v, voice.currentStep);
+  }
+
+  // Retraso del paso en muestras: swing en los pasos pares (2.º, 4.º...)
+  // más el microtiming del paso, ambos como fracción del periodo medido
+  uint32_t stepDelay(const VoiceBase& voice, unsigned int step) const {
+      if (voice.clockPeriod == 0) return 0;
+      float x = 0.0f;
+      if (step & 1) {
+          x += 0.5f * voice.swing;
       }
+      if (voice.microtimingOn) {
+          x += voice.microtiming[step] * 0.01f;
+      }
+      return static_cast<uint32_t>(x * voice.clockPeriod + 0.5f);
+  }
+
+  // Compuertas, acentos y ratchets del paso step, en el momento en que suena
+  template <typename Voice>
+  void fireStep(Voice& voice, int v, unsigned int step) {
+      voice.stepEvent = true;
+      voice.hitEvent = voice.hitAt(step);
+      voice.accentEvent = voice.accentAt(step);
 
       // Procesar según modo
       if (gateMode == TURING_MODE) {
           voice.turing = 0;
-          for (unsigned int i = 0; i < voice.par_l; i++) {
-              voice.turing |= voice.sequence[(voice.currentStep + i) % (voice.par_l + voice.par_p)];
+          for (unsigned int i = 0; i < std::min(voice.par_l, TURING_BITS); i++) {
+              voice.turing |= voice.sequence[(step + i) % (voice.par_l + voice.par_p)];
               voice.turing <<= 1;
           }
       } else {
           voice.gateOn = false;
-          if (voice.sequence[voice.currentStep]) {
+          voice.gateCountdown = 0;
+          if (voice.hitAt(step)) {
               voice.gatePulse.trigger(1e-3f);
-              if (gateMode == GATE_MODE) {
+              voice.gateCountdown = lengthSamples(voice, voice.gateLength, GATE_LENGTH_INPUT, v);
+              if (gateMode == GATE_MODE || voice.gateCountdown > 0) {
                   voice.gateOn = true;
               }
           }
@@ -605,15 +2977,194 @@ struct Puya : Module {
 
       // Procesar acentos
       voice.accOn = false;
-      if (voice.par_a && voice.accents.at(voice.currentStep)) {
+      voice.accentCountdown = 0;
+      if (voice.accentAt(step)) {
           voice.accentPulse.trigger(1e-3f);
-          if (gateMode == GATE_MODE) {
+          voice.accentCountdown = lengthSamples(voice, voice.accentLength, ACCENT_LENGTH_INPUT, v);
+          if (gateMode == GATE_MODE || voice.accentCountdown > 0) {
               voice.accOn = true;
           }
       }
+
+      scheduleRatchets(voice, v, step);
+  }
+
+  // Duración en muestras de una compuerta: fracción del periodo medido
+  // (manual + CV). 0 = sin duración propia o periodo aún sin medir.
+  uint32_t lengthSamples(const VoiceBase& voice, float length, int input, int v) {
+      if (voice.clockPeriod == 0) return 0;
+      float x = clamp(length + getParameterizedVoltage(input, v) * 0.1f, 0.0f, 1.0f);
+      if (x <= 0.0f) return 0;
+      return std::max(static_cast<uint32_t>(x * voice.clockPeriod), 1u);
+  }
+
+  // ¿La voz v está cronometrada (directa o indirectamente) por la voz j?
+  bool clockedBy(int v, int j) const {
+      for (int hops = 0; hops < NUM_VOICES_MAX; hops++) {
+          if (activeVoice(v).clockSource == VoiceBase::CLOCK_MASTER) return false;
+          v = activeVoice(v).clockVoice;
+          if (v == j) return true;
+      }
+      return true;  // ciclo
+  }
+
+  // Ordena las voces por profundidad en la cadena de relojes y elige la
+  // voz de referencia del ciclo maestro. Las voces dentro de un ciclo (sólo
+  // posible desde un JSON manipulado) vuelven al reloj maestro.
+  void updateRouting() {
+      std::array<int, NUM_VOICES_MAX> depth;
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          VoiceBase& voice = activeVoice(v);
+          if (voice.clockSource != VoiceBase::CLOCK_MASTER && clockedBy(voice.clockVoice, v)) {
+              voice.clockSource = VoiceBase::CLOCK_MASTER;
+          }
+      }
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          depth[v] = 0;
+          for (int x = v; activeVoice(x).clockSource != VoiceBase::CLOCK_MASTER && depth[v] < NUM_VOICES_MAX;
+               x = activeVoice(x).clockVoice) {
+              depth[v]++;
+          }
+      }
+      masterVoice = 0;
+      while (masterVoice < NUM_VOICES_MAX - 1 && activeVoice(masterVoice).clockSource != VoiceBase::CLOCK_MASTER) {
+          masterVoice++;
+      }
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          voiceOrder[v] = v;
+      }
+      std::stable_sort(voiceOrder.begin(), voiceOrder.end(),
+                       [&](int a, int b) { return depth[a] < depth[b]; });
+      routingDirty = false;
+  }
+
+  // Programa los disparos extra del paso repartidos en el periodo medido
+  template <typename Voice>
+  void scheduleRatchets(Voice& voice, int v, unsigned int step) {
+      voice.ratchetRemaining = 0;
+      if (gateMode == TURING_MODE || voice.clockPeriod == 0) return;
+
+      int count = voice.ratchets;
+      if (inputs[RATCHET_INPUT].isConnected()) {
+          count += static_cast<int>(inputs[RATCHET_INPUT].getPolyVoltage(v));
+      }
+      count = clamp(count, 1, MAX_RATCHETS);
+      if (count == 1) return;
+
+      bool accent = voice.accentAt(step);
+      if (!voice.hitAt(step) || (voice.ratchetAccentsOnly && !accent)) return;
+
+      // La cuenta atrás se descuenta ya en esta muestra (process() atiende
+      // los ratchets pendientes después del paso): +1 para que el primer
+      // disparo extra caiga a un intervalo, como los siguientes
+      voice.ratchetInterval = std::max(voice.clockPeriod / count, 1u);
+      voice.ratchetCountdown = voice.ratchetInterval + 1;
+      voice.ratchetRemaining = count - 1;
+      voice.ratchetAccent = accent;
+
+      // En modo compuerta los pasos con ratchet se emiten como disparos
+      voice.gateOn = false;
+      voice.accOn = false;
+      voice.gateCountdown = 0;
+      voice.accentCountdown = 0;
+  }
+
+  void fireRatchet(VoiceBase& voice) {
+      voice.gatePulse.trigger(1e-3f);
+      voice.hitEvent = true;
+      if (voice.ratchetAccent) {
+          voice.accentPulse.trigger(1e-3f);
+          voice.accentEvent = true;
+      }
+      voice.ratchetCountdown = voice.ratchetInterval;
+      voice.ratchetRemaining--;
+  }
+
+  // Evalúa las combinaciones booleanas sobre la palabra de estado de las
+  // voces. Sólo aportan bit las voces que avanzaron un paso de la rejilla
+  // en esta muestra (el hit de ese paso, sin swing ni microtiming); las
+  // demás cuentan como silencio. Así voces polimétricas o con otro reloj
+  // no repiten su último hit cada vez que avanza otra voz, y un reset sin
+  // paso no dispara nada.
+  template <unsigned int N>
+  void processComposites(const Voices<N>& voices, const ProcessArgs& args) {
+      bool stepped = false;
+      unsigned int state = 0;
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          const VoiceT<N>& voice = voices[v];
+          if (!voice.gridEvent) continue;
+          stepped = true;
+          state |= static_cast<unsigned int>(voice.gridHit) << v;
+      }
+
+      if (stepped) {
+          for (auto& composite : composites) {
+              bool on = composite.eval(state);
+              if (on) {
+                  composite.pulse.trigger(1e-3f);
+              }
+              composite.on = on && (gateMode == GATE_MODE);
+          }
+      }
+
+      for (int c = 0; c < NUM_COMPOSITES; c++) {
+          Composite& composite = composites[c];
+          bool cpulse = composite.pulse.process(args.sampleTime);
+          outputs[COMPOSITE_OUTPUT].setVoltage((composite.on || cpulse) ? 10.0f : 0.0f, c);
+      }
+  }
+
+  // Posición de un parámetro en el panel: perilla + CV de la voz actual
+  float panelPosition(int param, int input) {
+      return clamp(params[param].getValue() + getParameterizedVoltage(input, currentVoice) / 9.0f, 0.0f, 1.0f);
+  }
+
+  void readPanelPositions(VoiceBase& voice) {
+    voice.positions[VoiceBase::POS_K] = panelPosition(K_PARAM, K_INPUT);
+    voice.positions[VoiceBase::POS_L] = panelPosition(L_PARAM, L_INPUT);
+    voice.positions[VoiceBase::POS_R] = panelPosition(R_PARAM, R_INPUT);
+    voice.positions[VoiceBase::POS_P] = panelPosition(P_PARAM, P_INPUT);
+    voice.positions[VoiceBase::POS_A] = panelPosition(A_PARAM, A_INPUT);
+    voice.positions[VoiceBase::POS_S] = panelPosition(S_PARAM, S_INPUT);
+    voice.positionsValid = true;
   }
 
+  template <typename Voice>
   void updateVoiceParameters(Voice& voice) {
+    // En morph el patrón lo decide el camino, no las perillas
+    if (voice.morphing) return;
+
+    readPanelPositions(voice);
+    applyPositions(voice);
+  }
+
+  // Regenera una sola vez y sólo si los parámetros cambiaron. En modo
+  // banco K sólo elige la entrada.
+  template <typename Voice>
+  void applyPositions(Voice& voice) {
+    if (voice.patternBank) {
+        if (!voice.positionsValid) {
+            positionsFromParameters(voice);
+        }
+        selectBankEntry(voice, &voice - &voicesOf<Voice::WIDTH>()[0], mixedPosition(voice, Voice::POS_K));
+        return;
+    }
+    if (mapPositions(voice)) {
+        voice.par_last = voice.par_l + voice.par_r + voice.par_a + voice.par_k + voice.par_p + voice.par_s;
+        voice.literal = false;
+        voice.calculate = true;
+        resetVoice(voice);      // Regenerar patrón
+    }
+  }
+
+  // Posiciones de la voz, con el sorteo retenido de RND mezclado, ->
+  // parámetros. Devuelve si algo cambió.
+  bool mapPositions(VoiceBase& voice) {
+    float x[VoiceBase::NUM_POSITIONS];
+    for (int i = 0; i < VoiceBase::NUM_POSITIONS; i++) {
+        x[i] = mixedPosition(voice, i);
+    }
+
     // Guardar estado anterior para comparación
     unsigned int oldParamSum = voice.par_l + voice.par_r + voice.par_a + 
                              voice.par_k + voice.par_p + voice.par_s;
@@ -622,85 +3173,60 @@ struct Puya : Module {
     voice.par_k_last = voice.par_k;
     voice.par_l_last = voice.par_l;
     voice.par_a_last = voice.par_a;
+    uint32_t oldNecklace = voice.necklaceId;
 
     // Calcular parámetros de longitud y relleno
-    voice.par_l = static_cast<unsigned int>(1.0f + 15.0f * 
-        clamp(params[L_PARAM].getValue() + getParameterizedVoltage(L_INPUT, currentVoice) / 9.0f, 
-              0.0f, 1.0f));
-    voice.par_p = static_cast<unsigned int>((32.0f - voice.par_l) * 
-        clamp(params[P_PARAM].getValue() + getParameterizedVoltage(P_INPUT, currentVoice) / 9.0f, 
-              0.0f, 1.0f));
+    voice.par_l = mapLength(voice, x[VoiceBase::POS_L]);
+    voice.par_p = mapPad(voice.par_l, x[VoiceBase::POS_P]);
 
     // Calcular rotación y relleno principal
-    voice.par_r = static_cast<unsigned int>((voice.par_l + voice.par_p - 1.0f) * 
-        clamp(params[R_PARAM].getValue() + getParameterizedVoltage(R_INPUT, currentVoice) / 9.0f, 
-              0.0f, 1.0f));
-    voice.par_k = static_cast<unsigned int>(1.0f + (voice.par_l - 1.0f) * 
-        clamp(params[K_PARAM].getValue() + getParameterizedVoltage(K_INPUT, currentVoice) / 9.0f, 
-              0.0f, 1.0f));
+    voice.par_r = static_cast<unsigned int>((voice.par_l + voice.par_p - 1.0f) * x[VoiceBase::POS_R]);
+    voice.par_k = mapHits(voice, x[VoiceBase::POS_K]);
 
     // Calcular acentos y desplazamiento
-    voice.par_a = static_cast<unsigned int>(voice.par_k * 
-        clamp(params[A_PARAM].getValue() + getParameterizedVoltage(A_INPUT, currentVoice) / 9.0f, 
-              0.0f, 1.0f));
+    voice.par_a = static_cast<unsigned int>(voice.par_k * x[VoiceBase::POS_A]);
 
     if (voice.par_a == 0) {
         voice.par_s = 0;
     } else {
-        voice.par_s = static_cast<unsigned int>((voice.par_k - 1.0f) * 
-            clamp(params[S_PARAM].getValue() + getParameterizedVoltage(S_INPUT, currentVoice) / 9.0f, 
-                  0.0f, 1.0f));
+        voice.par_s = static_cast<unsigned int>((voice.par_k - 1.0f) * x[VoiceBase::POS_S]);
     }
 
     // Verificar cambios
     unsigned int newParamSum = voice.par_l + voice.par_r + voice.par_a + 
                            voice.par_k + voice.par_p + voice.par_s;
-                           
-    if (newParamSum != oldParamSum) {
-        voice.par_last = newParamSum;
-        voice.calculate = true;
-        saveVoiceState(voice);  // Guardar estado antes de regenerar
-        resetVoice(voice);      // Regenerar patrón
-    }
+    return newParamSum != oldParamSum || voice.necklaceId != oldNecklace;
+  }
 
-    // Procesar entrada de CV aleatorio
+  static float mixedPosition(const VoiceBase& voice, int i) {
+    return voice.positions[i] + (voice.randomDraw[i] - voice.positions[i]) * voice.randomAmount;
+  }
+
+  // Muestreo y retención de RND_INPUT (canal por voz) en el flanco elegido:
+  // un sorteo del generador de la voz para los seis parámetros y una sola
+  // regeneración. Al volver a 0V la voz regresa a sus posiciones.
+  template <typename Voice>
+  void randomizeVoice(Voice& voice, int v) {
+    if (voice.morphing) return;
+    float amount = 0.0f;
     if (inputs[RND_INPUT].isConnected()) {
-        float rndCV = getParameterizedVoltage(RND_INPUT, currentVoice) / 10.0f;  // Normalizar a 0-1
-        if (rndCV > 0.0f) {
-          // Aplicar aleatoriedad a los parámetros proporcionalmente al voltaje
-          float randomAmount = rndCV; // 0-1 basado en el voltaje de entrada
-          
-          // Modificar todos los parámetros aleatoriamente
-         voice.par_k = static_cast<unsigned int>(1.0f + (voice.par_l - 1.0f) * 
-             (params[K_PARAM].getValue() * (1.0f - randomAmount) + random::uniform() * randomAmount));
-  
-         voice.par_l = static_cast<unsigned int>(1.0f + 15.0f * 
-              (params[L_PARAM].getValue() * (1.0f - randomAmount) + random::uniform() * randomAmount));
-  
-          voice.par_r = static_cast<unsigned int>((voice.par_l + voice.par_p - 1.0f) * 
-              (params[R_PARAM].getValue() * (1.0f - randomAmount) + random::uniform() * randomAmount));
-  
-          voice.par_p = static_cast<unsigned int>((32.0f - voice.par_l) * 
-              (params[P_PARAM].getValue() * (1.0f - randomAmount) + random::uniform() * randomAmount));
-  
-         voice.par_a = static_cast<unsigned int>(voice.par_k * 
-             (params[A_PARAM].getValue() * (1.0f - randomAmount) + random::uniform() * randomAmount));
-  
-         voice.par_s = static_cast<unsigned int>((voice.par_k - 1.0f) * 
-             (params[S_PARAM].getValue() * (1.0f - randomAmount) + random::uniform() * randomAmount));
-  
-          voice.calculate = true;
-        }
+        amount = clamp(getParameterizedVoltage(RND_INPUT, v) / 10.0f, 0.0f, 1.0f);
+    }
+    if (amount <= 0.0f && voice.randomAmount <= 0.0f) return;
+
+    voice.randomAmount = amount;
+    if (amount > 0.0f) {
+        voice.drawRandom();
+    }
+    if (!voice.positionsValid) {
+        positionsFromParameters(voice);
     }
+    applyPositions(voice);
   }
 
-  void updateLights(const ProcessArgs& args) {
+  void updateLights(const VoiceBase& voice, const ProcessArgs& args) {
     const float lightDecayRate = 10.0f;
-    float deltaTime = args.sampleTime;
-
-    Voice& voice = voices[currentVoice];
-    bool gpulse = voice.gatePulse.process(1.0f / args.sampleRate);
-    bool apulse = voice.accentPulse.process(1.0f / args.sampleRate);
+    float deltaTime = args.sampleTime * lightDivider.getDivision();
 
     // Actualizar brillo de las luces
     bool clkActive = inputs[CLK_INPUT].getVoltage() > 0.0f;
@@ -708,37 +3234,24 @@ struct Puya : Module {
     lights[CLK_LIGHT].setBrightness(
         clamp(clkActive ? 1.0f : clkBrightness - deltaTime * lightDecayRate, 0.0f, 1.0f));
 
-    bool gateActive = voice.gateOn || gpulse;
+    bool gateActive = voice.gateHigh;
     float gateBrightness = lights[GATE_LIGHT].getBrightness();
     lights[GATE_LIGHT].setBrightness(
         clamp(gateActive ? 1.0f : gateBrightness - deltaTime * lightDecayRate, 0.0f, 1.0f));
 
-    bool accentActive = voice.accOn || apulse;
+    bool accentActive = voice.accentHigh;
     float accentBrightness = lights[ACCENT_LIGHT].getBrightness();
     lights[ACCENT_LIGHT].setBrightness(
         clamp(accentActive ? 1.0f : accentBrightness - deltaTime * lightDecayRate, 0.0f, 1.0f));
  }
 
-  void saveVoiceState(Voice& voice) {
+  void saveVoiceState(VoiceBase& voice) {
+    if (voice.morphing) return;
+
     // Guardar todos los parámetros principales
-    voice.par_k = static_cast<unsigned int>(1.0f + (voice.par_l - 1.0f) * 
-        clamp(params[K_PARAM].getValue() + getParameterizedVoltage(K_INPUT, currentVoice) / 9.0f, 
-              0.0f, 1.0f));
-    voice.par_l = static_cast<unsigned int>(1.0f + 15.0f * 
-        clamp(params[L_PARAM].getValue() + getParameterizedVoltage(L_INPUT, currentVoice) / 9.0f, 
-              0.0f, 1.0f));
-    voice.par_r = static_cast<unsigned int>((voice.par_l + voice.par_p - 1.0f) * 
-        clamp(params[R_PARAM].getValue() + getParameterizedVoltage(R_INPUT, currentVoice) / 9.0f, 
-              0.0f, 1.0f));
-    voice.par_p = static_cast<unsigned int>((32.0f - voice.par_l) * 
-        clamp(params[P_PARAM].getValue() + getParameterizedVoltage(P_INPUT, currentVoice) / 9.0f, 
-              0.0f, 1.0f));
-    voice.par_a = static_cast<unsigned int>(voice.par_k * 
-        clamp(params[A_PARAM].getValue() + getParameterizedVoltage(A_INPUT, currentVoice) / 9.0f, 
-              0.0f, 1.0f));
-    voice.par_s = static_cast<unsigned int>((voice.par_k - 1.0f) * 
-        clamp(params[S_PARAM].getValue() + getParameterizedVoltage(S_INPUT, currentVoice) / 9.0f, 
-              0.0f, 1.0f));
+    readPanelPositions(voice);
+    if (voice.patternBank) return;
+    mapPositions(voice);
 
     // Guardar últimos valores para comparación
     voice.par_k_last = voice.par_k;
@@ -747,26 +3260,44 @@ struct Puya : Module {
     voice.par_last = voice.par_k + voice.par_l + voice.par_r + voice.par_p + voice.par_s + voice.par_a;
   }
 
+  // Posición de perilla que devuelve value al truncar span * x: el centro
+  // del intervalo, para que restaurar las perillas no altere los parámetros
+  static float knobPosition(unsigned int value, float span) {
+      return (span > 0.0f) ? clamp((value + 0.5f) / span, 0.0f, 1.0f) : 0.0f;
+  }
+
+  // Posiciones que reproducen los parámetros actuales de la voz
+  void positionsFromParameters(VoiceBase& voice) {
+    uint32_t size = bankSize.load(std::memory_order_relaxed);
+    if (voice.patternBank && voice.bankEntry >= 0 && size > 0) {
+        voice.positions[VoiceBase::POS_K] = knobPosition(voice.bankEntry, static_cast<float>(size));
+    } else if (voice.catalog) {
+        const Necklaces& catalog = necklaces();
+        uint32_t index = voice.necklaceId - catalog.id(voice.par_l, 0);
+        voice.positions[VoiceBase::POS_K] = knobPosition(index, catalog.count(voice.par_l) - 1.0f);
+    } else {
+        voice.positions[VoiceBase::POS_K] = knobPosition(voice.par_k - 1, voice.par_l - 1.0f);
+    }
+    voice.positions[VoiceBase::POS_L] = knobPosition(voice.par_l - 1, maxVoiceLength(voice) - 1.0f);
+    voice.positions[VoiceBase::POS_R] = knobPosition(voice.par_r, voice.par_l + voice.par_p - 1.0f);
+    voice.positions[VoiceBase::POS_P] = knobPosition(voice.par_p, static_cast<float>(maxLength) - voice.par_l);
+    voice.positions[VoiceBase::POS_A] = knobPosition(voice.par_a, voice.par_k);
+    voice.positions[VoiceBase::POS_S] = knobPosition(voice.par_s, voice.par_k - 1.0f);
+    voice.positionsValid = true;
+  }
+
+  template <typename Voice>
   void loadVoiceState(Voice& voice) {
-    // Restaurar parámetros de la voz a los controles
-    params[K_PARAM].setValue(
-        clamp((voice.par_k - 1.0f) / (voice.par_l - 1.0f), 0.0f, 1.0f)
-    );
-    params[L_PARAM].setValue(
-        clamp((voice.par_l - 1.0f) / 15.0f, 0.0f, 1.0f)
-    );
-    params[R_PARAM].setValue(
-        clamp(static_cast<float>(voice.par_r) / (voice.par_l + voice.par_p - 1.0f), 0.0f, 1.0f)
-    );
-    params[P_PARAM].setValue(
-        clamp(static_cast<float>(voice.par_p) / (32.0f - voice.par_l), 0.0f, 1.0f)
-    );
-    params[A_PARAM].setValue(
-        clamp(static_cast<float>(voice.par_a) / voice.par_k, 0.0f, 1.0f)
-    );
-    params[S_PARAM].setValue(
-        clamp(static_cast<float>(voice.par_s) / (voice.par_k - 1.0f), 0.0f, 1.0f)
-    );
+    // Restaurar parámetros de la voz a los controles (sin la aleatoriedad)
+    if (!voice.positionsValid) {
+        positionsFromParameters(voice);
+    }
+    params[K_PARAM].setValue(voice.positions[Voice::POS_K]);
+    params[L_PARAM].setValue(voice.positions[Voice::POS_L]);
+    params[R_PARAM].setValue(voice.positions[Voice::POS_R]);
+    params[P_PARAM].setValue(voice.positions[Voice::POS_P]);
+    params[A_PARAM].setValue(voice.positions[Voice::POS_A]);
+    params[S_PARAM].setValue(voice.positions[Voice::POS_S]);
 
     // Regenerar patrón si es necesario
     if (voice.par_last != (voice.par_k + voice.par_l + voice.par_r + voice.par_p + voice.par_s + voice.par_a)) {
@@ -776,10 +3307,132 @@ struct Puya : Module {
   }
 };
 
+const uint32_t Puya::RESET_WINDOWS[Puya::NUM_RESET_WINDOWS] = {0, 1, 2, 4, 8, 16, 32};
+
+// Geometría de un collar en el display: la voz ocupa todo el display o,
+// en la vista de conjunto, un anillo propio (la voz 1 por fuera)
+struct NecklaceGeometry {
+  float cx, cy;
+  float r1;   // radio de los acentos
+  float r2;   // radio de los pasos
+  float dot;  // radio de cada paso
+
+  NecklaceGeometry(Vec size, int ring, bool overlay, unsigned int len) {
+      Rect b = Rect(Vec(2.0, 2.0), size.minus(Vec(2.0, 2.0)));
+      cx = 0.5f * b.size.x + 1.0f;
+      cy = 0.5f * b.size.y - 12.0f;
+      if (overlay) {
+          r1 = (0.45f - 0.09f * ring) * b.size.x;
+          r2 = r1 - 0.05f * b.size.x;
+      } else {
+          r1 = 0.45f * b.size.x;
+          r2 = 0.35f * b.size.x;
+      }
+
+      // Radio de los pasos: se reduce para ciclos largos (64/128 pasos)
+      dot = std::min(overlay ? 2.0f : 3.0f, static_cast<float>(M_PI) * r2 / std::max(len, 1u));
+  }
+
+  Vec point(unsigned int i, unsigned int len, bool accent) const {
+      float r = accent ? r1 : r2;
+      float a = 2.0f * M_PI * i / len - 0.5f * M_PI;
+      return Vec(cx + r * std::cos(a), cy + r * std::sin(a));
+  }
+};
+
+// Capa estática de una voz: círculos, pasos y trayectoria. Vive dentro de
+// un FramebufferWidget y dibuja su propia copia del patrón, que sólo se
+// renueva (y ensucia el framebuffer) cuando el patrón de la voz cambia.
+struct PuyaNecklaceLayer : TransparentWidget {
+  Puya* module = nullptr;
+  int voiceIndex = 0;
+  NVGcolor color;
+
+  // Patrón y vista dibujados en el framebuffer
+  typedef StepMask<MAX_SEQUENCE_LEN> Mask;
+  Mask sequence;
+  Mask accents;
+  unsigned int length = 0;
+  unsigned int hits = 0;
+  bool overlay = false;
+
+  // Copia el patrón de la voz; devuelve si hay que redibujar
+  bool update(bool overlay_) {
+      const VoiceBase& voice = module->activeVoice(voiceIndex);
+      Mask voiceSequence, voiceAccents;
+      module->copyPattern(voiceIndex, voiceSequence, voiceAccents);
+      unsigned int len = std::min(voice.par_l + voice.par_p, MAX_SEQUENCE_LEN);
+      if (len == length && voice.par_k == hits && overlay_ == overlay
+          && voiceSequence == sequence && voiceAccents == accents) {
+          return false;
+      }
+      sequence = voiceSequence;
+      accents = voiceAccents;
+      length = len;
+      hits = voice.par_k;
+      overlay = overlay_;
+      return true;
+  }
+
+  void draw(const DrawArgs& args) override {
+      if (!module || length == 0) return;
+      NVGcontext* vg = args.vg;
+      NecklaceGeometry g(box.size, voiceIndex, overlay, length);
+      NVGcolor dim = nvgRGBA(color.r * 127, color.g * 127, color.b * 127, 0xff);
+
+      // Círculos con el color de la voz
+      nvgBeginPath(vg);
+      nvgStrokeColor(vg, dim);
+      nvgStrokeWidth(vg, 1.0f);
+      nvgCircle(vg, g.cx, g.cy, g.r1);
+      nvgCircle(vg, g.cx, g.cy, g.r2);
+      nvgStroke(vg);
+
+      // Pasos inactivos
+      nvgBeginPath(vg);
+      for (unsigned int i = 0; i < length; i++) {
+          if (!sequence[i]) {
+              Vec p = g.point(i, length, accents[i]);
+              nvgCircle(vg, p.x, p.y, g.dot);
+          }
+      }
+      nvgStrokeColor(vg, dim);
+      nvgStroke(vg);
+
+      // Trayectoria con el color de la voz
+      nvgBeginPath(vg);
+      bool first = true;
+      sequence.forEach([&](unsigned int i) {
+          if (i >= length) return;
+          Vec p = g.point(i, length, accents[i]);
+          if (hits == 1) {
+              nvgCircle(vg, p.x, p.y, g.dot);
+          }
+          if (first) {
+              nvgMoveTo(vg, p.x, p.y);
+              first = false;
+          } else {
+              nvgLineTo(vg, p.x, p.y);
+          }
+      });
+      nvgClosePath(vg);
+      nvgStrokeColor(vg, color);
+      nvgStroke(vg);
+
+      // Anillos de pasos activos con el color de la voz
+      nvgBeginPath(vg);
+      sequence.forEach([&](unsigned int i) {
+          if (i >= length) return;
+          Vec p = g.point(i, length, accents[i]);
+          nvgCircle(vg, p.x, p.y, g.dot);
+      });
+      nvgStroke(vg);
+  }
+};
+
 // Widget de visualización para el módulo Puya
 struct PuyaDisplay : TransparentWidget {
   Puya* module;
-  std::shared_ptr<Font> font;
   float y1;
   float yh;
 
@@ -791,111 +3444,68 @@ struct PuyaDisplay : TransparentWidget {
     nvgRGB(0x00, 0xff, 0x00)  // Voz 4: Verde
 };
 
+  // Una capa en caché por voz; cada cuadro sólo dibuja los marcadores
+  FramebufferWidget* layerBuffers[NUM_VOICES_MAX];
+  PuyaNecklaceLayer* layers[NUM_VOICES_MAX];
+
   PuyaDisplay(float y1_, float yh_) {
       y1 = y1_;
       yh = yh_;
-      font = APP->window->loadFont(asset::plugin(pluginInstance, "res/hdad-segment14-1.002/Segment14.ttf"));
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          layers[v] = new PuyaNecklaceLayer;
+          layers[v]->voiceIndex = v;
+          layers[v]->color = voiceColors[v];
+          layerBuffers[v] = new FramebufferWidget;
+          layerBuffers[v]->addChild(layers[v]);
+          addChild(layerBuffers[v]);
+      }
   }
 
-  void drawPolygon(NVGcontext* vg) {
-      if (!module) return;
-
-      int voiceIndex = clamp((int)module->params[Puya::VOICE_PARAM].getValue() - 1, 0, NUM_VOICES_MAX - 1);
-      Voice& voice = module->voices[voiceIndex];
-      NVGcolor voiceColor = voiceColors[voiceIndex];
-
-      Rect b = Rect(Vec(2.0, 2.0), box.size.minus(Vec(2.0, 2.0)));
-      float cx = 0.5f * b.size.x + 1.0f;
-      float cy = 0.5f * b.size.y - 12.0f;
-      const float r1 = 0.45f * b.size.x;
-      const float r2 = 0.35f * b.size.x;
-
-      // Círculos con el color de la voz
-      nvgBeginPath(vg);
-      nvgStrokeColor(vg, nvgRGBA(voiceColor.r * 127, voiceColor.g * 127, voiceColor.b * 127, 0xff));
-      nvgFillColor(vg, voiceColor);
-      nvgStrokeWidth(vg, 1.0f);
-      nvgCircle(vg, cx, cy, r1);
-      nvgCircle(vg, cx, cy, r2);
-      nvgStroke(vg);
-
-      const unsigned int len = voice.par_l + voice.par_p;
-
-      // Dibujar la secuencia con el color de la voz
-      nvgStrokeColor(vg, voiceColor);
-      nvgBeginPath(vg);
-      bool first = true;
-
-      // Pasos inactivos
-      for (unsigned int i = 0; i < len; i++) {
-          if (!voice.sequence[i]) {
-              float r = voice.accents[i] ? r1 : r2;
-              float x = cx + r * std::cosf(2.0f * M_PI * i / len - 0.5f * M_PI);
-              float y = cy + r * std::sinf(2.0f * M_PI * i / len - 0.5f * M_PI);
+  int selectedVoice() const {
+      return clamp((int)module->params[Puya::VOICE_PARAM].getValue() - 1, 0, NUM_VOICES_MAX - 1);
+  }
 
-              nvgBeginPath(vg);
-              nvgFillColor(vg, nvgRGBA(0x30, 0x10, 0x10, 0x00)); // Relleno transparente
-              nvgStrokeWidth(vg, 1.0f);
-              nvgStrokeColor(vg, nvgRGBA(voiceColor.r * 127, voiceColor.g * 127, voiceColor.b * 127, 0xff));
-              nvgCircle(vg, x, y, 3.0f);
-              nvgFill(vg);
-              nvgStroke(vg);
-          }
-      }
+  // Las capas visibles se redibujan sólo si cambió su patrón, la vista o
+  // el tamaño del display
+  void step() override {
+      if (module) {
+          bool overlay = module->overlayDisplay;
+          int selected = selectedVoice();
+          for (int v = 0; v < NUM_VOICES_MAX; v++) {
+              FramebufferWidget* fb = layerBuffers[v];
+              PuyaNecklaceLayer* layer = layers[v];
+              fb->visible = overlay || v == selected;
+              if (!fb->visible) continue;
 
-      // Trayectoria con el color de la voz
-      nvgBeginPath(vg);
-      nvgStrokeColor(vg, voiceColor);
-      nvgStrokeWidth(vg, 1.0f);
-      for (unsigned int i = 0; i < len; i++) {
-          if (voice.sequence[i]) {
-              float a = static_cast<float>(i) / len;
-              float r = voice.accents[i] ? r1 : r2;
-              float x = cx + r * std::cosf(2.0f * M_PI * a - 0.5f * M_PI);
-              float y = cy + r * std::sinf(2.0f * M_PI * a - 0.5f * M_PI);
-
-              Vec p(x, y);
-              if (voice.par_k == 1) {
-                  nvgCircle(vg, x, y, 3.0f);
+              layer->module = module;
+              if (!fb->box.size.equals(box.size)) {
+                  fb->box.size = box.size;
+                  layer->box.size = box.size;
+                  fb->setDirty();
               }
-              if (first) {
-                  nvgMoveTo(vg, p.x, p.y);
-                  first = false;
-              } else {
-                  nvgLineTo(vg, p.x, p.y);
+              if (layer->update(overlay)) {
+                  fb->setDirty();
               }
           }
       }
-      nvgClosePath(vg);
-      nvgStroke(vg);
+      TransparentWidget::step();
+  }
 
-      // Anillos de pasos activos con el color de la voz
-      for (unsigned int i = 0; i < len; i++) {
-          if (voice.sequence[i]) {
-              float r = voice.accents[i] ? r1 : r2;
-              float x = cx + r * std::cosf(2.0f * M_PI * i / len - 0.5f * M_PI);
-              float y = cy + r * std::sinf(2.0f * M_PI * i / len - 0.5f * M_PI);
-
-              nvgBeginPath(vg);
-              nvgFillColor(vg, nvgRGBA(0x30, 0x10, 0x10, 0x00)); // Relleno transparente
-              nvgStrokeWidth(vg, 1.0f);
-              nvgStrokeColor(vg, voiceColor);
-              nvgCircle(vg, x, y, 3.0f);
-              nvgFill(vg);
-              nvgStroke(vg);
-          }
-      }
-
-      // Indicador del paso actual con el color de la voz
-      unsigned int i = voice.currentStep;
-      if (i < len) {  // Validación de índice
-          float r = voice.accents[i] ? r1 : r2;
-          float x = cx + r * std::cosf(2.0f * M_PI * i / len - 0.5f * M_PI);
-          float y = cy + r * std::sinf(2.0f * M_PI * i / len - 0.5f * M_PI);
+  // Indicador del paso actual de cada voz visible, sobre su capa
+  void drawMarkers(NVGcontext* vg) {
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          const PuyaNecklaceLayer* layer = layers[v];
+          unsigned int len = layer->length;
+          unsigned int i = module->activeVoice(v).currentStep;
+          if (!layerBuffers[v]->visible || i >= len) continue;
+
+          NecklaceGeometry g(box.size, v, layer->overlay, len);
+          Vec p = g.point(i, len, layer->accents[i]);
+          NVGcolor voiceColor = voiceColors[v];
           nvgBeginPath(vg);
           nvgStrokeColor(vg, voiceColor);
-          nvgFillColor(vg, voice.sequence[i] ? voiceColor : nvgRGBA(0x30, 0x10, 0x10, 0x00));
-          nvgCircle(vg, x, y, 3.0f);
+          nvgFillColor(vg, layer->sequence[i] ? voiceColor : nvgRGBA(0x30, 0x10, 0x10, 0x00));
+          nvgCircle(vg, p.x, p.y, g.dot);
           nvgStrokeWidth(vg, 1.5f);
           nvgFill(vg);
           nvgStroke(vg);
@@ -914,22 +3524,35 @@ struct PuyaDisplay : TransparentWidget {
       nvgStrokeColor(args.vg, nvgRGBA(0xd0, 0xd0, 0xd0, 0x00)); // Borde transparente
       nvgStroke(args.vg);
 
-      // Dibujar visualización de secuencia con el color de la voz actual
-      drawPolygon(args.vg);
+      // Capas en caché de las voces visibles y, encima, el paso actual
+      TransparentWidget::draw(args);
+      drawMarkers(args.vg);
 
       // Dibujar texto de parámetros con el color de la voz
+      std::shared_ptr<Font> font = APP->window->loadFont(pluginFont("res/hdad-segment14-1.002/Segment14.ttf"));
+      if (!font) return;
       nvgFontSize(args.vg, 8.0f);
       nvgFontFaceId(args.vg, font->handle);
 
-      int voiceIndex = clamp((int)module->params[Puya::VOICE_PARAM].getValue() - 1, 0, NUM_VOICES_MAX - 1);
-      Voice& voice = module->voices[voiceIndex];
+      int voiceIndex = selectedVoice();
+      const VoiceBase& voice = module->activeVoice(voiceIndex);
       NVGcolor textColor = voiceColors[voiceIndex];
 
       Vec textPos = Vec(15.0f, 105.0f);
       nvgFillColor(args.vg, textColor);
       char str[20];
-      snprintf(str, sizeof(str), "%2d %2d %2d", static_cast<int>(voice.par_k), 
-              static_cast<int>(voice.par_l), static_cast<int>(voice.par_r));
+      if (voice.patternBank && voice.bankEntry >= 0) {
+          // Modo banco: entrada del archivo (desde 1) y longitud
+          snprintf(str, sizeof(str), "B%-4d %2d", static_cast<int>(voice.bankEntry) + 1,
+                  static_cast<int>(voice.par_l + voice.par_p));
+      } else if (voice.catalog) {
+          // Modo catálogo: ID del collar en lugar del relleno
+          snprintf(str, sizeof(str), "#%-4u %2d", static_cast<unsigned int>(voice.necklaceId),
+                  static_cast<int>(voice.par_r));
+      } else {
+          snprintf(str, sizeof(str), "%2d %2d %2d", static_cast<int>(voice.par_k), 
+                  static_cast<int>(voice.par_l), static_cast<int>(voice.par_r));
+      }
       nvgText(args.vg, textPos.x, textPos.y - 11.0f, str, nullptr);
 
       snprintf(str, sizeof(str), "%2d %2d %2d", static_cast<int>(voice.par_p), 
@@ -990,6 +3613,11 @@ struct PuyaWidget : ModuleWidget {
 
   PuyaWidget() = default;  // Constructor por defecto
 
+  // Registro periódico de los contadores de rendimiento
+  static constexpr double STATS_LOG_INTERVAL = 10.0;  // segundos
+  PuyaStats::Snapshot statsLogged;
+  bool statsLogging = false;
+
   explicit PuyaWidget(Puya* module) {
       setModule(module);
 
@@ -999,7 +3627,7 @@ struct PuyaWidget : ModuleWidget {
       {
           auto* panel = new SvgPanel();
           panel->box.size = box.size;
-          panel->setBackground(APP->window->loadSvg(asset::plugin(pluginInstance, "res/Puya.svg")));
+          panel->setBackground(pluginSvg("res/Puya.svg"));
           addChild(panel);
       }
 
@@ -1056,6 +3684,341 @@ struct PuyaWidget : ModuleWidget {
       addChild(createLightCentered<MultiColorLight>(Vec(35.0f, 340.0f), module, Puya::ACCENT_LIGHT));
   }
 
+  // Hilo de la interfaz: interpreta las entradas pedidas al banco de
+  // patrones y escribe una línea en el log cada STATS_LOG_INTERVAL
+  // segundos con las tasas del intervalo
+  void step() override {
+      ModuleWidget::step();
+      Puya* puya = getModule<Puya>();
+      if (puya) {
+          puya->servicePatternBank();
+      }
+      if (!puya || !puya->statsLog) {
+          statsLogging = false;
+          return;
+      }
+      if (statsLogging && std::chrono::duration<double>(PuyaStats::Clock::now() - statsLogged.time).count() < STATS_LOG_INTERVAL) {
+          return;
+      }
+
+      PuyaStats::Snapshot now = puya->stats.snapshot();
+      if (statsLogging) {
+          PuyaStats::Snapshot d = now.since(statsLogged);
+          double seconds = now.seconds(statsLogged);
+          INFO("Puya %lld: process %.0f ns (máx %.0f ns), regeneraciones/s %.1f %.1f %.1f %.1f (media %.1f us, máx %.1f us), "
+               "flancos perdidos %llu duplicados %llu, iteraciones aleatorias %llu",
+               static_cast<long long>(puya->id), d.processAverageNanos(), static_cast<double>(now.processMaxNanos),
+               d.voiceRegenerations(0) / seconds, d.voiceRegenerations(1) / seconds,
+               d.voiceRegenerations(2) / seconds, d.voiceRegenerations(3) / seconds,
+               d.regenAverageNanos() * 1e-3, now.regenMaxNanos * 1e-3,
+               static_cast<unsigned long long>(d.missedEdges), static_cast<unsigned long long>(d.duplicateEdges),
+               static_cast<unsigned long long>(d.randomIterations));
+      }
+      statsLogged = now;
+      statsLogging = true;
+  }
+
+  // Submenú de rendimiento: contadores desde el último reinicio
+  static void appendStatsMenu(Menu* menu, Puya* puya) {
+      PuyaStats::Snapshot now = puya->stats.snapshot();
+      PuyaStats::Snapshot d = now.since(puya->statsBase);
+      double seconds = std::max(now.seconds(puya->statsBase), 1e-3);
+      double budget = 1e9 / APP->engine->getSampleRate();  // ns por muestra
+
+      menu->addChild(createMenuLabel(string::f("process(): media %.0f ns (%.2f%%), máx %.0f ns",
+          d.processAverageNanos(), 100.0 * d.processAverageNanos() / budget,
+          static_cast<double>(now.processMaxNanos))));
+      menu->addChild(createMenuLabel(string::f("Regeneración: media %.1f µs, máx %.1f µs",
+          d.regenAverageNanos() * 1e-3, now.regenMaxNanos * 1e-3)));
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          menu->addChild(createMenuLabel(string::f("Voz %d: %.2f/s (patrón %llu, acentos %llu, catálogo %llu)",
+              v + 1, d.voiceRegenerations(v) / seconds,
+              static_cast<unsigned long long>(d.stages[v][PuyaStats::PATTERN_STAGE]),
+              static_cast<unsigned long long>(d.stages[v][PuyaStats::ACCENT_STAGE]),
+              static_cast<unsigned long long>(d.stages[v][PuyaStats::CATALOG_STAGE]))));
+      }
+      menu->addChild(createMenuLabel(string::f("Flancos de reloj: %llu perdidos, %llu duplicados",
+          static_cast<unsigned long long>(d.missedEdges), static_cast<unsigned long long>(d.duplicateEdges))));
+      menu->addChild(createMenuLabel(string::f("Iteraciones aleatorias: %llu",
+          static_cast<unsigned long long>(d.randomIterations))));
+
+      menu->addChild(new MenuSeparator());
+      menu->addChild(createBoolPtrMenuItem("Registrar en el log cada 10 s", "", &puya->statsLog));
+      menu->addChild(createMenuItem("Reiniciar contadores", "",
+          [=]() {
+              puya->statsBase = puya->stats.snapshot();
+              puya->stats.resetMaxRequested.store(true, std::memory_order_relaxed);
+          }
+      ));
+
+      // Traza de entradas para reproducir picos fuera del directo
+      float sampleRate = APP->engine->getSampleRate();
+      menu->addChild(new MenuSeparator());
+      menu->addChild(createMenuLabel("Traza de entradas"));
+      if (puya->trace.isRecording()) {
+          menu->addChild(createMenuItem("Detener grabación",
+              string::f("%.1f s", puya->trace.recordedFrames() / sampleRate),
+              [=]() { puya->trace.stop(); }
+          ));
+          if (puya->trace.droppedEvents() > 0) {
+              menu->addChild(createMenuLabel(string::f("%llu eventos perdidos",
+                  static_cast<unsigned long long>(puya->trace.droppedEvents()))));
+          }
+      } else {
+          menu->addChild(createMenuItem("Grabar...", "",
+              [=]() {
+                  osdialog_filters* filters = osdialog_filters_parse("Traza de Puya:puyatrace");
+                  char* path = osdialog_file(OSDIALOG_SAVE, nullptr, "puya.puyatrace", filters);
+                  osdialog_filters_free(filters);
+                  if (!path) return;
+                  if (!puya->startTrace(path, sampleRate)) {
+                      WARN("Puya: no se pudo grabar la traza %s", path);
+                  }
+                  std::free(path);
+              }
+          ));
+      }
+      bool replaying = puya->replayBusy.load(std::memory_order_acquire);
+      menu->addChild(createMenuItem("Reproducir...", replaying ? "en curso" : "",
+          [=]() {
+              osdialog_filters* filters = osdialog_filters_parse("Traza de Puya:puyatrace");
+              char* path = osdialog_file(OSDIALOG_OPEN, nullptr, nullptr, filters);
+              osdialog_filters_free(filters);
+              if (!path) return;
+              puya->startReplay(path);
+              std::free(path);
+          },
+          replaying
+      ));
+      if (!replaying && puya->replayResult.valid) {
+          const Puya::ReplayResult& r = puya->replayResult;
+          menu->addChild(createMenuLabel(string::f("%s: %.1f s en %.2f s (x%.1f)",
+              system::getFilename(r.path).c_str(), r.seconds, r.wallSeconds, r.seconds / std::max(r.wallSeconds, 1e-9))));
+          menu->addChild(createMenuLabel(string::f("process(): media %.0f ns, máx %.0f ns a los %.2f s",
+              r.averageNanos, r.maxNanos, r.maxFrame / r.sampleRate)));
+          menu->addChild(createMenuLabel(string::f("Regeneraciones %llu, hash %016llx",
+              static_cast<unsigned long long>(r.regenerations), static_cast<unsigned long long>(r.hash))));
+      }
+  }
+
+  // Resumen de una combinación para el menú, p. ej. "OR 1234 -2"
+  static std::string compositeLabel(const Composite& composite) {
+      std::string label = Composite::opName(composite.op);
+      label += " ";
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          if ((composite.include >> v) & 1) label += std::to_string(v + 1);
+      }
+      if (composite.exclude) {
+          label += " -";
+          for (int v = 0; v < NUM_VOICES_MAX; v++) {
+              if ((composite.exclude >> v) & 1) label += std::to_string(v + 1);
+          }
+      }
+      return label;
+  }
+
+  // Submenú de ajustes de una voz
+  static void appendVoiceMenu(Menu* menu, Puya* puya, int v) {
+      VoiceBase* voice = &puya->activeVoice(v);
+
+      menu->addChild(createCheckMenuItem("Catálogo de collares (K = ID)", "",
+          [=]() { return voice->catalog; },
+          [=]() { puya->requestCatalog(v, !voice->catalog); }
+      ));
+      menu->addChild(createCheckMenuItem("Banco de patrones (K = entrada)", "",
+          [=]() { return voice->patternBank; },
+          [=]() { puya->requestPatternBank(v, !voice->patternBank); },
+          !voice->patternBank && !puya->patternFile.isOpen()
+      ));
+      if (voice->patternBank && voice->bankEntry >= 0 && puya->patternFile.isOpen()) {
+          std::string name = puya->patternFile.name(voice->bankEntry);
+          menu->addChild(createMenuLabel(string::f("Entrada %d%s%s", static_cast<int>(voice->bankEntry) + 1,
+                                                   name.empty() ? "" : ": ", name.c_str())));
+      }
+
+      // Índice inverso: el campo muestra el resultado al escribir y Enter
+      // lo aplica a la voz
+      struct PatternSearchField : ui::TextField {
+          Puya* puya = nullptr;
+          int voice = 0;
+          ui::MenuLabel* result = nullptr;
+          bool indexing = true;
+
+          // Mientras el índice se construye el resultado espera; al
+          // terminar se busca lo que ya esté escrito
+          void step() override {
+              if (indexing) {
+                  indexing = puya->patternIndexPending();
+                  if (indexing) {
+                      result->text = "indexando…";
+                  } else {
+                      showResult();
+                  }
+              }
+              ui::TextField::step();
+          }
+
+          void onChange(const event::Change& e) override {
+              if (!indexing) showResult();
+          }
+
+          void showResult() {
+              PatternIndex::Match match = puya->findParameters(getText());
+              if (!match.found) {
+                  result->text = getText().empty() ? "" : "Sin resultado";
+              } else {
+                  std::string params = string::f("L %u K %u R %u P %u A %u S %u",
+                                                 match.l, match.k, match.r, match.p, match.a, match.s);
+                  result->text = match.exact() ? "Exacto: " + params
+                      : string::f("Distancia %u: ", match.hitDistance + match.accentDistance) + params;
+              }
+          }
+
+          void onAction(const event::Action& e) override {
+              if (indexing) return;
+              puya->requestParameters(voice, puya->findParameters(getText()));
+              ui::MenuOverlay* overlay = getAncestorOfType<ui::MenuOverlay>();
+              if (overlay) overlay->requestDelete();
+          }
+      };
+      bool searchable = Puya::indexGenerator(puya->style) && !voice->catalog && !voice->patternBank && !voice->morphing;
+      if (searchable) {
+          // Empieza a indexar en segundo plano antes de abrir la búsqueda
+          Puya::patternIndex(puya->style, puya->maxLength);
+      }
+      menu->addChild(createSubmenuItem("Buscar parámetros", "",
+          [=](Menu* menu) {
+              menu->addChild(createMenuLabel("Ritmo (x hit, X acento, . silencio), Enter aplica"));
+              PatternSearchField* field = new PatternSearchField;
+              field->box.size.x = 220.0f;
+              field->placeholder = "x..x..x...x.x...";
+              field->puya = puya;
+              field->voice = v;
+              field->result = createMenuLabel("");
+              menu->addChild(field);
+              menu->addChild(field->result);
+          },
+          !searchable
+      ));
+
+      menu->addChild(createSubmenuItem("Morph", voice->morphing ? "activo" : "",
+          [=](Menu* menu) {
+              menu->addChild(createMenuItem("Fijar A = patrón actual", voice->morphAValid ? "✔" : "",
+                  [=]() { puya->setMorphEndpoint(v, false); }
+              ));
+              menu->addChild(createMenuItem("Fijar B = patrón actual", voice->morphBValid ? "✔" : "",
+                  [=]() { puya->setMorphEndpoint(v, true); }
+              ));
+              menu->addChild(createCheckMenuItem("Activo", "",
+                  [=]() { return voice->morphing; },
+                  [=]() { puya->setMorphing(v, !voice->morphing); },
+                  !voice->canMorph()
+              ));
+              menu->addChild(new FloatPtrSlider(&voice->morphAmount, "Posición A-B", 0.0f));
+          }
+      ));
+
+      menu->addChild(createSubmenuItem("Mutación", voice->mutating ? (voice->mutationLocked ? "bloqueada" : "activa") : "",
+          [=](Menu* menu) {
+              menu->addChild(createBoolPtrMenuItem("Activa", "", &voice->mutating));
+              menu->addChild(new FloatPtrSlider(&voice->mutationAmount, "Probabilidad", 0.1f));
+              menu->addChild(createBoolPtrMenuItem("Conservar hits", "", &voice->mutationKeepHits));
+              menu->addChild(createBoolPtrMenuItem("Bloquear (guardar patrón)", "", &voice->mutationLocked));
+          }
+      ));
+
+      menu->addChild(createSubmenuItem("Aleatoriedad (RND)", "",
+          [=](Menu* menu) {
+              menu->addChild(createCheckMenuItem("Nuevo sorteo en cada paso", "",
+                  [=]() { return voice->randomSync == VoiceBase::RANDOM_ON_STEP; },
+                  [=]() { voice->randomSync = VoiceBase::RANDOM_ON_STEP; }
+              ));
+              menu->addChild(createCheckMenuItem("Nuevo sorteo al inicio del ciclo", "",
+                  [=]() { return voice->randomSync == VoiceBase::RANDOM_ON_CYCLE; },
+                  [=]() { voice->randomSync = VoiceBase::RANDOM_ON_CYCLE; }
+              ));
+              menu->addChild(createMenuItem("Nueva semilla", string::f("%016llx", static_cast<unsigned long long>(voice->randomSeed)),
+                  [=]() { voice->seedRandom(random::u64()); }
+              ));
+          }
+      ));
+
+      menu->addChild(new MenuSeparator());
+      menu->addChild(createMenuLabel("Probabilidad"));
+      menu->addChild(new FloatPtrSlider(&voice->hitProbability, "Hits"));
+      menu->addChild(new FloatPtrSlider(&voice->accentProbability, "Acentos"));
+      menu->addChild(createBoolPtrMenuItem("Ponderar por acento", "", &voice->accentWeighted));
+
+      menu->addChild(new MenuSeparator());
+      std::vector<std::string> ratchetLabels;
+      for (int n = 1; n <= MAX_RATCHETS; n++) {
+          ratchetLabels.push_back(n == 1 ? "Apagado" : string::f("x%d", n));
+      }
+      menu->addChild(createIndexSubmenuItem("Ratchets", ratchetLabels,
+          [=]() { return static_cast<size_t>(voice->ratchets - 1); },
+          [=](size_t index) { voice->ratchets = static_cast<int>(index) + 1; }
+      ));
+      menu->addChild(createBoolPtrMenuItem("Ratchet sólo en acentos", "", &voice->ratchetAccentsOnly));
+
+      // 0 = duración del modo (disparo o paso completo)
+      menu->addChild(new MenuSeparator());
+      menu->addChild(createMenuLabel("Duración (fracción del periodo)"));
+      menu->addChild(new FloatPtrSlider(&voice->gateLength, "Compuerta", 0.0f));
+      menu->addChild(new FloatPtrSlider(&voice->accentLength, "Acento", 0.0f));
+
+      // Swing: 100% retrasa los pasos pares medio periodo
+      menu->addChild(new MenuSeparator());
+      menu->addChild(new FloatPtrSlider(&voice->swing, "Swing", 0.0f));
+      menu->addChild(createSubmenuItem("Microtiming", voice->microtimingOn ? "activo" : "",
+          [=](Menu* menu) {
+              menu->addChild(createBoolPtrMenuItem("Activo", "", &voice->microtimingOn));
+              menu->addChild(new FloatPtrSlider(&voice->humanizeAmount, "Retraso máximo", 0.2f));
+              menu->addChild(createMenuItem("Humanizar", "",
+                  [=]() {
+                      for (uint8_t& offset : voice->microtiming) {
+                          offset = static_cast<uint8_t>(random::uniform() * voice->humanizeAmount * MAX_MICROTIMING);
+                      }
+                      voice->microtimingOn = true;
+                  }
+              ));
+              menu->addChild(createMenuItem("Borrar", "",
+                  [=]() { std::fill(std::begin(voice->microtiming), std::end(voice->microtiming), 0); }
+              ));
+          }
+      ));
+
+      // Fuente de reloj: se descartan las que crearían un ciclo
+      menu->addChild(new MenuSeparator());
+      menu->addChild(createMenuLabel("Reloj"));
+      menu->addChild(createCheckMenuItem("Reloj maestro", "",
+          [=]() { return voice->clockSource == VoiceBase::CLOCK_MASTER; },
+          [=]() { voice->clockSource = VoiceBase::CLOCK_MASTER; puya->routingDirty = true; }
+      ));
+      for (int j = 0; j < NUM_VOICES_MAX; j++) {
+          if (j == v) continue;
+          bool cyclic = puya->clockedBy(j, v);
+          for (int source = VoiceBase::CLOCK_HITS; source <= VoiceBase::CLOCK_ACCENTS; source++) {
+              VoiceBase::ClockSource clockSource = static_cast<VoiceBase::ClockSource>(source);
+              std::string text = string::f("%s de voz %d", source == VoiceBase::CLOCK_HITS ? "Hits" : "Acentos", j + 1);
+              menu->addChild(createCheckMenuItem(text, "",
+                  [=]() { return voice->clockSource == clockSource && voice->clockVoice == j; },
+                  [=]() { voice->clockVoice = j; voice->clockSource = clockSource; puya->routingDirty = true; },
+                  cyclic
+              ));
+          }
+      }
+
+      // Relación p:q con el reloj maestro (no afecta a las voces en cascada)
+      std::vector<std::string> ratioLabels;
+      for (const StepRatio& r : STEP_RATIOS) {
+          ratioLabels.push_back(string::f("%d:%d", r.p, r.q));
+      }
+      menu->addChild(createIndexSubmenuItem("Relación de paso", ratioLabels,
+          [=]() { return static_cast<size_t>(voice->ratio); },
+          [=](size_t index) { voice->ratio = static_cast<int>(index); }
+      ));
+  }
+
   void appendContextMenu(Menu* menu) override {
       if (!module) return;
 
@@ -1087,9 +4050,7 @@ struct PuyaWidget : ModuleWidget {
               
               puya->style = ps;
               // Reiniciar todas las voces al cambiar el estilo
-              for (auto& voice : puya->voices) {
-                  puya->resetVoice(voice);
-              }
+              puya->resetVoices();
           }
 
           void step() override {
@@ -1116,6 +4077,177 @@ struct PuyaWidget : ModuleWidget {
           &PuyaGateModeItem::puya, puya,
           &PuyaGateModeItem::gm, Puya::TURING_MODE
       ));
+      menu->addChild(construct<PuyaGateModeItem>(
+          &MenuItem::text, "Audio (oscilador)",
+          &PuyaGateModeItem::puya, puya,
+          &PuyaGateModeItem::gm, Puya::AUDIO_MODE
+      ));
+
+      // Ítem del menú para la longitud máxima del ciclo
+      struct PuyaMaxLengthItem : MenuItem {
+          Puya* puya = nullptr;
+          unsigned int length = 32;
+
+          void onAction(const event::Action& e) override {
+              if (!puya) return;
+
+              // Lo aplica process(): pasa las voces al nuevo ancho,
+              // reacotadas y regeneradas
+              puya->pendingMaxLength = length;
+          }
+
+          void step() override {
+              rightText = (puya && puya->maxLength == length) ? "✔" : "";
+              MenuItem::step();
+          }
+      };
+
+      // Ajustes por voz
+      menu->addChild(new MenuSeparator());
+      menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Voces"));
+      menu->addChild(createBoolPtrMenuItem("Mostrar todas las voces", "", &puya->overlayDisplay));
+      for (int v = 0; v < NUM_VOICES_MAX; v++) {
+          menu->addChild(createSubmenuItem(string::f("Voz %d", v + 1), "",
+              [=](Menu* menu) {
+                  appendVoiceMenu(menu, puya, v);
+              }
+          ));
+      }
+
+      // Menú de salidas compuestas: operación y voces de cada canal
+      menu->addChild(new MenuSeparator());
+      menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Salidas Compuestas"));
+      for (int c = 0; c < NUM_COMPOSITES; c++) {
+          menu->addChild(createSubmenuItem(string::f("Canal %d", c + 1), compositeLabel(puya->composites[c]),
+              [=](Menu* menu) {
+                  Composite* composite = &puya->composites[c];
+
+                  menu->addChild(createMenuLabel("Operación"));
+                  for (int op = 0; op < Composite::NUM_OPS; op++) {
+                      menu->addChild(createCheckMenuItem(Composite::opName(static_cast<Composite::Op>(op)), "",
+                          [=]() { return composite->op == op; },
+                          [=]() { composite->op = static_cast<Composite::Op>(op); composite->update(); }
+                      ));
+                  }
+
+                  menu->addChild(new MenuSeparator());
+                  menu->addChild(createMenuLabel("Voces"));
+                  for (int v = 0; v < NUM_VOICES_MAX; v++) {
+                      menu->addChild(createCheckMenuItem(string::f("Voz %d", v + 1), "",
+                          [=]() { return (composite->include >> v) & 1; },
+                          [=]() { composite->include ^= 1u << v; composite->update(); }
+                      ));
+                  }
+
+                  menu->addChild(new MenuSeparator());
+                  menu->addChild(createMenuLabel("Excluir (NOT)"));
+                  for (int v = 0; v < NUM_VOICES_MAX; v++) {
+                      menu->addChild(createCheckMenuItem(string::f("Voz %d", v + 1), "",
+                          [=]() { return (composite->exclude >> v) & 1; },
+                          [=]() { composite->exclude ^= 1u << v; composite->update(); }
+                      ));
+                  }
+              }
+          ));
+      }
+
+      // Botón Sync: inmediato o en cola hasta la próxima frontera
+      menu->addChild(new MenuSeparator());
+      menu->addChild(createIndexSubmenuItem("Botón Sync",
+          {"Inmediato", "Próximo tiempo fuerte", "Fin del ciclo maestro"},
+          [=]() { return static_cast<size_t>(puya->syncMode); },
+          [=](size_t index) { puya->syncMode = static_cast<Puya::SyncMode>(index); }
+      ));
+      menu->addChild(createMenuItem("Cancelar sincronización en cola", "",
+          [=]() { puya->syncQueued = false; },
+          !puya->syncQueued
+      ));
+
+      // Reset tardío respecto al reloj que todavía cuenta como simultáneo
+      std::vector<std::string> windowLabels;
+      for (int i = 0; i < Puya::NUM_RESET_WINDOWS; i++) {
+          uint32_t window = Puya::RESET_WINDOWS[i];
+          windowLabels.push_back(window ? string::f("%u muestras", window) : "Apagada");
+      }
+      menu->addChild(createIndexSubmenuItem("Ventana de reset", windowLabels,
+          [=]() {
+              size_t index = 0;
+              for (int i = 0; i < Puya::NUM_RESET_WINDOWS; i++) {
+                  if (Puya::RESET_WINDOWS[i] <= puya->resetWindow) index = i;
+              }
+              return index;
+          },
+          [=](size_t index) { puya->resetWindow = Puya::RESET_WINDOWS[index]; }
+      ));
+
+      // Banco de patrones externo (archivo de texto, una entrada por línea)
+      menu->addChild(new MenuSeparator());
+      menu->addChild(createSubmenuItem("Banco de patrones",
+          puya->patternFile.isOpen() ? string::f("%u", static_cast<unsigned int>(puya->patternFile.size())) : "",
+          [=](Menu* menu) {
+              if (puya->patternFile.isOpen()) {
+                  menu->addChild(createMenuLabel(system::getFilename(puya->patternFile.path())));
+              }
+              menu->addChild(createMenuItem("Cargar archivo...", "",
+                  [=]() {
+                      osdialog_filters* filters = osdialog_filters_parse("Texto:txt");
+                      char* path = osdialog_file(OSDIALOG_OPEN, nullptr, nullptr, filters);
+                      osdialog_filters_free(filters);
+                      if (!path) return;
+                      if (!puya->loadPatternBank(path)) {
+                          WARN("Puya: no se pudo abrir el banco de patrones %s", path);
+                      }
+                      std::free(path);
+                  }
+              ));
+              menu->addChild(createMenuItem("Quitar", "",
+                  [=]() { puya->loadPatternBank(""); },
+                  !puya->patternFile.isOpen()
+              ));
+          }
+      ));
+
+      // Banco de instantáneas: la recuperación se aplica al inicio del ciclo
+      menu->addChild(createSubmenuItem("Instantáneas", "",
+          [=](Menu* menu) {
+              menu->addChild(createSubmenuItem("Guardar", "",
+                  [=](Menu* menu) {
+                      for (int i = 0; i < NUM_SNAPSHOTS; i++) {
+                          menu->addChild(createMenuItem(string::f("Ranura %d", i + 1),
+                              puya->snapshots[i].valid ? "ocupada" : "",
+                              [=]() { puya->storeSnapshot(i); }
+                          ));
+                      }
+                  }
+              ));
+              menu->addChild(createSubmenuItem("Recuperar", "",
+                  [=](Menu* menu) {
+                      for (int i = 0; i < NUM_SNAPSHOTS; i++) {
+                          menu->addChild(createMenuItem(string::f("Ranura %d", i + 1), "",
+                              [=]() { puya->requestSnapshot(i); },
+                              !puya->snapshots[i].valid
+                          ));
+                      }
+                  }
+              ));
+          }
+      ));
+
+      menu->addChild(new MenuSeparator());
+      menu->addChild(createSubmenuItem("Rendimiento", "",
+          [=](Menu* menu) { appendStatsMenu(menu, puya); }
+      ));
+
+      // Menú de longitud máxima (limitado a la longitud compilada)
+      menu->addChild(new MenuSeparator());
+      menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Longitud Máxima"));
+      for (unsigned int length = 32; length <= MAX_SEQUENCE_LEN; length *= 2) {
+          menu->addChild(construct<PuyaMaxLengthItem>(
+              &MenuItem::text, string::f("%u pasos", length),
+              &PuyaMaxLengthItem::puya, puya,
+              &PuyaMaxLengthItem::length, length
+          ));
+      }
 
       // Menú de estilo de patrón
       menu->addChild(new MenuSeparator());
@@ -0,0 +1,84 @@
+#pragma once
+
+// Bus de expansión de Puya
+//
+// Puya publica en cada muestra el estado completo de sus voces en el doble
+// buffer de su rightExpander (Rack intercambia producerMessage y
+// consumerMessage al final de cada muestra). Un expansor colocado a la
+// derecha lo lee directamente, sin cables ni codificación en voltajes:
+//
+//   Module* m = leftExpander.module;
+//   if (m && m->model == modelPuya) {
+//       const PuyaBusMessage* msg = static_cast<const PuyaBusMessage*>(m->rightExpander.consumerMessage);
+//       if (msg->version == PuyaBusMessage::VERSION) { ... }
+//   }
+//
+// El mensaje llega con una muestra de retraso. Las máscaras siempre ocupan
+// 128 bits (bit i = paso i) sea cual sea la longitud máxima del módulo.
+//
+// El expansor de Puya (PuyaExpander) usa el bus en los dos sentidos: lee
+// aquí las salidas que Puya calcula para sus conectores y publica sus
+// entradas en el doble buffer de su propio leftExpander
+// (PuyaExpanderMessage), que Puya lee del mismo modo.
+
+#include "StepMask.hpp"
+#include <cstdint>
+
+// Conector reflejado de un módulo a otro: canales (0 = sin cable) y voltajes
+struct PuyaBusPort {
+    static const int MAX_CHANNELS = 16;
+    uint8_t channels;
+    float voltages[MAX_CHANNELS];
+};
+
+struct PuyaBusMessage {
+    static const uint32_t VERSION = 2;
+    static const int NUM_VOICES = 4;
+    static const int NUM_OUTPUTS = 4;
+    static const unsigned int MASK_WORDS = 2;
+
+    struct Voice {
+        uint64_t sequence[MASK_WORDS];    // hits del patrón (incluye relleno)
+        uint64_t accents[MASK_WORDS];     // acentos del patrón
+        uint64_t hitGate[MASK_WORDS];     // sorteo de probabilidad del ciclo
+        uint64_t accentGate[MASK_WORDS];
+        uint16_t length;                  // pasos del ciclo (l + p)
+        uint16_t step;                    // paso actual
+        uint32_t clockPeriod;             // periodo medido en muestras (0 = sin medir)
+        bool stepped;                     // avanzó un paso en esta muestra
+        bool cycleStart;                  // el paso es el 0 del ciclo
+        bool hit;                         // hit emitido en esta muestra
+        bool accent;                      // acento emitido en esta muestra
+        bool gate;                        // estado de la salida de compuerta
+        bool accentGateOn;                // estado de la salida de acentos
+    };
+
+    uint32_t version = VERSION;
+    uint32_t maxLength = 0;
+    int64_t frame = 0;                    // frame del motor de Rack al publicar
+    Voice voices[NUM_VOICES] = {};
+
+    // Salidas del expansor, en su orden: compuestas, análisis, fase y fin
+    // del ciclo maestro
+    PuyaBusPort outputs[NUM_OUTPUTS] = {};
+
+    template <typename T, unsigned int WORDS>
+    static void pack(const WordMask<T, WORDS>& mask, uint64_t* out) {
+        for (unsigned int i = 0; i < MASK_WORDS; i++) {
+            out[i] = (i < WORDS) ? static_cast<uint64_t>(mask.word(i)) : 0;
+        }
+    }
+};
+
+// Mensaje del expansor hacia Puya: sus entradas, en su orden (ratchets,
+// instantánea, morph, mutación, duración de compuerta y de acento,
+// relación de paso y banco de patrones), y qué salidas tienen cable
+struct PuyaExpanderMessage {
+    static const uint32_t VERSION = 1;
+    static const int NUM_INPUTS = 8;
+    static const int NUM_OUTPUTS = PuyaBusMessage::NUM_OUTPUTS;
+
+    uint32_t version = VERSION;
+    PuyaBusPort inputs[NUM_INPUTS] = {};
+    bool outputsConnected[NUM_OUTPUTS] = {};
+};
@@ -0,0 +1,153 @@
+#include "Catatumbo.hpp"
+#include "PuyaBus.hpp"
+#include <cstring>
+
+// Expansor de Puya: entradas y salidas adicionales en un panel propio de
+// 6HP, colocado a la derecha de Puya. No procesa nada: publica sus entradas
+// en PuyaExpanderMessage y escribe en sus salidas lo que Puya calculó para
+// ellas en PuyaBusMessage (ver PuyaBus.hpp). Cada sentido tiene una muestra
+// de retraso.
+struct PuyaExpander : Module {
+  enum ParamIds {
+      NUM_PARAMS
+  };
+
+  // En el orden de PuyaExpanderMessage::inputs
+  enum InputIds {
+      RATCHET_INPUT,
+      BANK_INPUT,
+      MORPH_INPUT,
+      MUTATE_INPUT,
+      GATE_LENGTH_INPUT,
+      ACCENT_LENGTH_INPUT,
+      RATIO_INPUT,
+      PATTERN_INPUT,
+      NUM_INPUTS
+  };
+
+  // En el orden de PuyaBusMessage::outputs
+  enum OutputIds {
+      COMPOSITE_OUTPUT,
+      ANALYSIS_OUTPUT,
+      MASTER_PHASE_OUTPUT,
+      MASTER_END_OUTPUT,
+      NUM_OUTPUTS
+  };
+
+  enum LightIds {
+      NUM_LIGHTS
+  };
+
+  static_assert(NUM_INPUTS == PuyaExpanderMessage::NUM_INPUTS, "entradas del expansor");
+  static_assert(NUM_OUTPUTS == PuyaBusMessage::NUM_OUTPUTS, "salidas del expansor");
+
+  PuyaExpander() {
+      config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+
+      configInput(RATCHET_INPUT, "Ratchets (1V por disparo extra)");
+      configInput(BANK_INPUT, "Instantánea (0-10V, 16 ranuras)");
+      configInput(MORPH_INPUT, "Morph A-B (0-10V)");
+      configInput(MUTATE_INPUT, "Probabilidad de mutación (0-10V)");
+      configInput(GATE_LENGTH_INPUT, "Duración de compuerta (0-10V = 0-100% del periodo)");
+      configInput(ACCENT_LENGTH_INPUT, "Duración de acento (0-10V = 0-100% del periodo)");
+      configInput(RATIO_INPUT, "Relación de paso (1V por entrada)");
+      configInput(PATTERN_INPUT, "Entrada del banco de patrones (0-10V)");
+      configOutput(COMPOSITE_OUTPUT, "Compuestas (booleanas entre voces)");
+      configOutput(ANALYSIS_OUTPUT, "Análisis (densidad, regularidad, síncopa, fase)");
+      configOutput(MASTER_PHASE_OUTPUT, "Fase del ciclo maestro (0-10V)");
+      configOutput(MASTER_END_OUTPUT, "Fin del ciclo maestro");
+
+      // Doble buffer de las entradas (lo lee Puya, a la izquierda)
+      leftExpander.producerMessage = new PuyaExpanderMessage;
+      leftExpander.consumerMessage = new PuyaExpanderMessage;
+  }
+
+  ~PuyaExpander() {
+      delete static_cast<PuyaExpanderMessage*>(leftExpander.producerMessage);
+      delete static_cast<PuyaExpanderMessage*>(leftExpander.consumerMessage);
+  }
+
+  void process(const ProcessArgs& args) override {
+      PuyaExpanderMessage* out = static_cast<PuyaExpanderMessage*>(leftExpander.producerMessage);
+      for (int i = 0; i < NUM_INPUTS; i++) {
+          out->inputs[i].channels = static_cast<uint8_t>(inputs[i].getChannels());
+          std::memcpy(out->inputs[i].voltages, inputs[i].voltages, sizeof(out->inputs[i].voltages));
+      }
+      for (int o = 0; o < NUM_OUTPUTS; o++) {
+          out->outputsConnected[o] = outputs[o].isConnected();
+      }
+      leftExpander.requestMessageFlip();
+
+      // Salidas: las de Puya si está a la izquierda, si no 0V
+      Module* m = leftExpander.module;
+      const PuyaBusMessage* bus = nullptr;
+      if (m && m->model == modelPuya) {
+          bus = static_cast<const PuyaBusMessage*>(m->rightExpander.consumerMessage);
+          if (bus->version != PuyaBusMessage::VERSION) bus = nullptr;
+      }
+      for (int o = 0; o < NUM_OUTPUTS; o++) {
+          if (!bus) {
+              outputs[o].setChannels(1);
+              outputs[o].setVoltage(0.0f);
+              continue;
+          }
+          const PuyaBusPort& port = bus->outputs[o];
+          outputs[o].setChannels(std::max(static_cast<int>(port.channels), 1));
+          for (int c = 0; c < port.channels; c++) {
+              outputs[o].setVoltage(port.voltages[c], c);
+          }
+          if (port.channels == 0) {
+              outputs[o].setVoltage(0.0f);
+          }
+      }
+  }
+};
+
+struct PuyaExpanderWidget : ModuleWidget {
+  explicit PuyaExpanderWidget(PuyaExpander* module) {
+      setModule(module);
+      box.size = Vec(15.0f * 6.0f, 380.0f);
+
+      {
+          auto* panel = new SvgPanel();
+          panel->box.size = box.size;
+          panel->setBackground(pluginSvg("res/puya-ext.svg"));
+          addChild(panel);
+      }
+
+      // Rejilla de 3 columnas, rótulo sobre cada puerto
+      auto gridPos = [](int col, int row) {
+          return Vec(15.0f + 30.0f * col, 50.0f + 34.0f * row);
+      };
+      auto addLabel = [this](Vec pos, const std::string& text) {
+          addChild(createPanelLabel(pos.minus(Vec(0.0f, 15.0f)), text));
+      };
+
+      addOutput(createOutputCentered<sp_Port>(gridPos(0, 0), module, PuyaExpander::COMPOSITE_OUTPUT));
+      addLabel(gridPos(0, 0), "LOGIC");
+      addInput(createInputCentered<sp_Port>(gridPos(1, 0), module, PuyaExpander::RATCHET_INPUT));
+      addLabel(gridPos(1, 0), "RATCH");
+      addInput(createInputCentered<sp_Port>(gridPos(2, 0), module, PuyaExpander::BANK_INPUT));
+      addLabel(gridPos(2, 0), "BANK");
+      addInput(createInputCentered<sp_Port>(gridPos(0, 1), module, PuyaExpander::MORPH_INPUT));
+      addLabel(gridPos(0, 1), "MORPH");
+      addInput(createInputCentered<sp_Port>(gridPos(1, 1), module, PuyaExpander::MUTATE_INPUT));
+      addLabel(gridPos(1, 1), "MUT");
+      addOutput(createOutputCentered<sp_Port>(gridPos(2, 1), module, PuyaExpander::ANALYSIS_OUTPUT));
+      addLabel(gridPos(2, 1), "ANLS");
+      addInput(createInputCentered<sp_Port>(gridPos(0, 2), module, PuyaExpander::GATE_LENGTH_INPUT));
+      addLabel(gridPos(0, 2), "GLEN");
+      addInput(createInputCentered<sp_Port>(gridPos(1, 2), module, PuyaExpander::ACCENT_LENGTH_INPUT));
+      addLabel(gridPos(1, 2), "ALEN");
+      addOutput(createOutputCentered<sp_Port>(gridPos(2, 2), module, PuyaExpander::MASTER_PHASE_OUTPUT));
+      addLabel(gridPos(2, 2), "PHASE");
+      addOutput(createOutputCentered<sp_Port>(gridPos(0, 3), module, PuyaExpander::MASTER_END_OUTPUT));
+      addLabel(gridPos(0, 3), "END");
+      addInput(createInputCentered<sp_Port>(gridPos(1, 3), module, PuyaExpander::RATIO_INPUT));
+      addLabel(gridPos(1, 3), "RATIO");
+      addInput(createInputCentered<sp_Port>(gridPos(2, 3), module, PuyaExpander::PATTERN_INPUT));
+      addLabel(gridPos(2, 3), "PATRN");
+  }
+};
+
+Model* modelPuyaExpander = createModel<PuyaExpander, PuyaExpanderWidget>("PuyaExpander");
@@ -0,0 +1,207 @@
+#pragma once
+
+// Contadores de rendimiento de Puya
+//
+// Siempre activos y baratos, sin locks. resetVoice también corre en el hilo
+// de la interfaz (al cambiar estilo, catálogo o banco), así que los
+// contadores que pueden tocar los dos hilos suman con fetch_add relaxed;
+// processCalls sólo lo escribe el hilo de audio y se queda en carga y
+// almacenamiento. La interfaz los lee con snapshot() para el submenú y el
+// registro periódico; las tasas salen de la diferencia entre dos
+// instantáneas y "reiniciar" sólo mueve la línea base de la interfaz.
+//
+// process() se cronometra con steady_clock una de cada PROCESS_SAMPLING
+// llamadas; las regeneraciones se cronometran todas (son raras).
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+struct PuyaStats {
+    static const int NUM_VOICES = 4;
+    static const uint32_t PROCESS_SAMPLING = 256;
+
+    // Etapas de una regeneración (resetVoice). Una regeneración del estilo
+    // pasa por dos etapas, así que se cuentan aparte de las regeneraciones.
+    enum Stage {
+        PATTERN_STAGE,   // generador del estilo
+        ACCENT_STAGE,    // reparto de acentos
+        CATALOG_STAGE,   // collar del catálogo
+        NUM_STAGES
+    };
+
+    typedef std::chrono::steady_clock Clock;
+    typedef std::atomic<uint64_t> Counter;
+
+    Counter processCalls;
+    Counter processTimed;
+    Counter processNanos;
+    Counter processMaxNanos;
+    Counter regenerations[NUM_VOICES];
+    Counter stages[NUM_VOICES][NUM_STAGES];
+    Counter regenTimed;
+    Counter regenNanos;
+    Counter regenMaxNanos;
+    Counter missedEdges;      // periodo > 1,5 veces el anterior
+    Counter duplicateEdges;   // periodo < 0,5 veces el anterior
+    Counter randomIterations; // vueltas de los bucles del estilo aleatorio
+
+    // La interfaz pide borrar los máximos; el hilo de audio lo atiende
+    std::atomic<bool> resetMaxRequested;
+
+    PuyaStats() {
+        Counter* all[] = {&processCalls, &processTimed, &processNanos, &processMaxNanos,
+                          &regenTimed, &regenNanos, &regenMaxNanos,
+                          &missedEdges, &duplicateEdges, &randomIterations};
+        for (Counter* c : all) c->store(0, std::memory_order_relaxed);
+        for (int v = 0; v < NUM_VOICES; v++) {
+            regenerations[v].store(0, std::memory_order_relaxed);
+            for (int s = 0; s < NUM_STAGES; s++) stages[v][s].store(0, std::memory_order_relaxed);
+        }
+        resetMaxRequested.store(false, std::memory_order_relaxed);
+    }
+
+    // Audio e interfaz pueden sumar a la vez
+    static void add(Counter& c, uint64_t n = 1) {
+        c.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    static void max(Counter& c, uint64_t n) {
+        uint64_t m = c.load(std::memory_order_relaxed);
+        while (n > m && !c.compare_exchange_weak(m, n, std::memory_order_relaxed)) {}
+    }
+
+    // Un patrón nuevo para la voz, sea cual sea el número de etapas
+    void regeneration(int voice) {
+        add(regenerations[voice]);
+    }
+
+    void stage(int voice, Stage stage) {
+        add(stages[voice][stage]);
+    }
+
+    // Intervalo entre dos flancos del reloj maestro frente al anterior (una
+    // vez por muestra, no por cada voz que lo sigue)
+    void clockEdge(uint32_t period, uint32_t previous) {
+        if (previous == 0) return;
+        if (2 * static_cast<uint64_t>(period) < previous) add(duplicateEdges);
+        else if (2 * static_cast<uint64_t>(period) > 3 * static_cast<uint64_t>(previous)) add(missedEdges);
+    }
+
+    // ¿Cronometrar esta llamada a process()?
+    bool sampleProcess() {
+        uint64_t calls = processCalls.load(std::memory_order_relaxed);
+        processCalls.store(calls + 1, std::memory_order_relaxed);
+        if (resetMaxRequested.load(std::memory_order_relaxed)) {
+            processMaxNanos.store(0, std::memory_order_relaxed);
+            regenMaxNanos.store(0, std::memory_order_relaxed);
+            resetMaxRequested.store(false, std::memory_order_relaxed);
+        }
+        return calls % PROCESS_SAMPLING == 0;
+    }
+
+    // Cronómetro de ámbito: process() o una regeneración
+    struct Timer {
+        Counter* timed;
+        Counter* nanos;
+        Counter* maxNanos;
+        Clock::time_point start;
+
+        Timer(Counter& timed_, Counter& nanos_, Counter& maxNanos_, bool active = true)
+            : timed(active ? &timed_ : nullptr), nanos(&nanos_), maxNanos(&maxNanos_) {
+            if (timed) start = Clock::now();
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        ~Timer() {
+            if (!timed) return;
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            add(*timed);
+            add(*nanos, ns);
+            max(*maxNanos, ns);
+        }
+    };
+
+    struct ProcessTimer : Timer {
+        explicit ProcessTimer(PuyaStats& s)
+            : Timer(s.processTimed, s.processNanos, s.processMaxNanos, s.sampleProcess()) {}
+    };
+
+    struct RegenerationTimer : Timer {
+        explicit RegenerationTimer(PuyaStats& s)
+            : Timer(s.regenTimed, s.regenNanos, s.regenMaxNanos) {}
+    };
+
+    // Copia no atómica para la interfaz
+    struct Snapshot {
+        Clock::time_point time;
+        uint64_t processCalls = 0;
+        uint64_t processTimed = 0;
+        uint64_t processNanos = 0;
+        uint64_t processMaxNanos = 0;
+        uint64_t regenerations[NUM_VOICES] = {};
+        uint64_t stages[NUM_VOICES][NUM_STAGES] = {};
+        uint64_t regenTimed = 0;
+        uint64_t regenNanos = 0;
+        uint64_t regenMaxNanos = 0;
+        uint64_t missedEdges = 0;
+        uint64_t duplicateEdges = 0;
+        uint64_t randomIterations = 0;
+
+        uint64_t voiceRegenerations(int voice) const {
+            return regenerations[voice];
+        }
+
+        double processAverageNanos() const {
+            return processTimed ? static_cast<double>(processNanos) / processTimed : 0.0;
+        }
+
+        double regenAverageNanos() const {
+            return regenTimed ? static_cast<double>(regenNanos) / regenTimed : 0.0;
+        }
+
+        // Contadores acumulados desde base (los máximos no se restan)
+        Snapshot since(const Snapshot& base) const {
+            Snapshot d = *this;
+            d.processCalls -= base.processCalls;
+            d.processTimed -= base.processTimed;
+            d.processNanos -= base.processNanos;
+            for (int v = 0; v < NUM_VOICES; v++) {
+                d.regenerations[v] -= base.regenerations[v];
+                for (int s = 0; s < NUM_STAGES; s++) d.stages[v][s] -= base.stages[v][s];
+            }
+            d.regenTimed -= base.regenTimed;
+            d.regenNanos -= base.regenNanos;
+            d.missedEdges -= base.missedEdges;
+            d.duplicateEdges -= base.duplicateEdges;
+            d.randomIterations -= base.randomIterations;
+            return d;
+        }
+
+        double seconds(const Snapshot& base) const {
+            return std::chrono::duration<double>(time - base.time).count();
+        }
+    };
+
+    Snapshot snapshot() const {
+        Snapshot s;
+        s.time = Clock::now();
+        s.processCalls = processCalls.load(std::memory_order_relaxed);
+        s.processTimed = processTimed.load(std::memory_order_relaxed);
+        s.processNanos = processNanos.load(std::memory_order_relaxed);
+        s.processMaxNanos = processMaxNanos.load(std::memory_order_relaxed);
+        for (int v = 0; v < NUM_VOICES; v++) {
+            s.regenerations[v] = regenerations[v].load(std::memory_order_relaxed);
+            for (int st = 0; st < NUM_STAGES; st++) s.stages[v][st] = stages[v][st].load(std::memory_order_relaxed);
+        }
+        s.regenTimed = regenTimed.load(std::memory_order_relaxed);
+        s.regenNanos = regenNanos.load(std::memory_order_relaxed);
+        s.regenMaxNanos = regenMaxNanos.load(std::memory_order_relaxed);
+        s.missedEdges = missedEdges.load(std::memory_order_relaxed);
+        s.duplicateEdges = duplicateEdges.load(std::memory_order_relaxed);
+        s.randomIterations = randomIterations.load(std::memory_order_relaxed);
+        return s;
+    }
+};
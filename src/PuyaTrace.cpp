@@ -0,0 +1,184 @@
+#include "PuyaTrace.hpp"
+#include "WidePath.hpp"
+#include <chrono>
+
+const char PuyaTrace::MAGIC[8] = {'P', 'U', 'Y', 'A', 'T', 'R', 'C', '1'};
+
+std::FILE* PuyaTrace::open(const std::string& path, const char* mode) {
+#ifdef _WIN32
+  std::wstring wpath = widePath(path);
+  if (wpath.empty()) return nullptr;
+  std::wstring wmode(mode, mode + std::strlen(mode));
+  return _wfopen(wpath.c_str(), wmode.c_str());
+#else
+  return std::fopen(path.c_str(), mode);
+#endif
+}
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t x) {
+  while (x >= 0x80) {
+    out.push_back(static_cast<uint8_t>(x | 0x80));
+    x >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(x));
+}
+
+static void putRaw(std::vector<uint8_t>& out, const void* p, size_t n) {
+  const uint8_t* b = static_cast<const uint8_t*>(p);
+  out.insert(out.end(), b, b + n);
+}
+
+static uint32_t floatBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+PuyaTraceRecorder::~PuyaTraceRecorder() {
+  requested.store(0, std::memory_order_relaxed);
+  abort.store(true, std::memory_order_relaxed);
+  if (writer.joinable()) writer.join();
+}
+
+bool PuyaTraceRecorder::start(const std::string& path, float sampleRate, const std::string& state) {
+  stop();
+  if (writer.joinable()) {
+    if (!finished.load(std::memory_order_acquire)) abort.store(true, std::memory_order_relaxed);
+    writer.join();
+  }
+  abort.store(false, std::memory_order_relaxed);
+
+  std::FILE* file = PuyaTrace::open(path, "wb");
+  if (!file) return false;
+
+  std::vector<uint8_t> header;
+  uint32_t version = PuyaTrace::VERSION;
+  uint32_t numSignals = last.size();
+  uint32_t length = state.size();
+  putRaw(header, PuyaTrace::MAGIC, sizeof(PuyaTrace::MAGIC));
+  putRaw(header, &version, sizeof(version));
+  putRaw(header, &sampleRate, sizeof(sampleRate));
+  putRaw(header, &numSignals, sizeof(numSignals));
+  putRaw(header, &length, sizeof(length));
+  putRaw(header, state.data(), state.size());
+  if (std::fwrite(header.data(), 1, header.size(), file) != header.size()) {
+    std::fclose(file);
+    return false;
+  }
+
+  if (ring.empty()) ring.resize(RING_SIZE);
+
+  // Los eventos pendientes de otra sesión se descartan al leerlos
+  uint32_t session = ++sessions;
+  if (session == 0) session = ++sessions;
+  filePath = path;
+  frames.store(0, std::memory_order_relaxed);
+  finished.store(false, std::memory_order_relaxed);
+  writer = std::thread(&PuyaTraceRecorder::run, this, file, session, numSignals);
+  requested.store(session, std::memory_order_release);
+  return true;
+}
+
+// Hilo de escritura: vacía el anillo cada pocos milisegundos hasta END
+void PuyaTraceRecorder::run(std::FILE* file, uint32_t session, unsigned int numSignals) {
+  std::vector<uint32_t> previous(numSignals, 0);
+  std::vector<uint8_t> out;
+  uint64_t lastFrame = 0;
+  bool end = false;
+
+  while (!end && !abort.load(std::memory_order_relaxed)) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t h = head.load(std::memory_order_acquire);
+    for (; t != h && !end; t++) {
+      const Event& e = ring[t & (RING_SIZE - 1)];
+      if (e.session != session) continue;
+      putVarint(out, e.frame - lastFrame);
+      lastFrame = e.frame;
+      putVarint(out, e.id);
+      if (e.id == PuyaTrace::END_ID) {
+        end = true;
+        break;
+      }
+      uint32_t bits = floatBits(e.value);
+      int32_t delta = static_cast<int32_t>(bits - previous[e.id]);
+      previous[e.id] = bits;
+      putVarint(out, (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31));
+    }
+    tail.store(t, std::memory_order_release);
+
+    if (!out.empty()) {
+      std::fwrite(out.data(), 1, out.size(), file);
+      out.clear();
+    }
+    if (!end) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+
+  std::fclose(file);
+  finished.store(true, std::memory_order_release);
+}
+
+bool PuyaTraceReader::open(const std::string& path) {
+  close();
+  file = PuyaTrace::open(path, "rb");
+  if (!file) return false;
+
+  char magic[sizeof(PuyaTrace::MAGIC)];
+  uint32_t version = 0, signals = 0, length = 0;
+  bool ok = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic)
+      && std::memcmp(magic, PuyaTrace::MAGIC, sizeof(magic)) == 0
+      && std::fread(&version, sizeof(version), 1, file) == 1 && version == PuyaTrace::VERSION
+      && std::fread(&sampleRate, sizeof(sampleRate), 1, file) == 1
+      && std::fread(&signals, sizeof(signals), 1, file) == 1 && signals < PuyaTrace::END_ID
+      && std::fread(&length, sizeof(length), 1, file) == 1;
+  if (ok) {
+    state.resize(length);
+    ok = length == 0 || std::fread(&state[0], 1, length, file) == length;
+  }
+  if (!ok) {
+    close();
+    return false;
+  }
+  numSignals = signals;
+  last.assign(numSignals, 0);
+  frame = 0;
+  return true;
+}
+
+void PuyaTraceReader::close() {
+  if (file) std::fclose(file);
+  file = nullptr;
+}
+
+bool PuyaTraceReader::readVarint(uint64_t& x) {
+  x = 0;
+  for (unsigned int shift = 0; shift < 64; shift += 7) {
+    int c = std::getc(file);
+    if (c == EOF) return false;
+    x |= static_cast<uint64_t>(c & 0x7F) << shift;
+    if (!(c & 0x80)) return true;
+  }
+  return false;
+}
+
+bool PuyaTraceReader::next(uint64_t& eventFrame, unsigned int& id, float& value) {
+  if (!file) return false;
+  uint64_t delta, signal, zigzag;
+  if (!readVarint(delta) || !readVarint(signal)) {
+    close();
+    frame++;  // truncada: termina tras la última muestra con eventos
+    return false;
+  }
+  frame += delta;
+  if (signal == PuyaTrace::END_ID || signal >= numSignals || !readVarint(zigzag)) {
+    if (signal != PuyaTrace::END_ID) frame++;
+    close();
+    return false;
+  }
+  uint32_t z = static_cast<uint32_t>(zigzag);
+  uint32_t bits = last[signal] + ((z >> 1) ^ (0u - (z & 1)));
+  last[signal] = bits;
+  std::memcpy(&value, &bits, sizeof(value));
+  eventFrame = frame;
+  id = static_cast<unsigned int>(signal);
+  return true;
+}
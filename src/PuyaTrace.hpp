@@ -0,0 +1,184 @@
+#pragma once
+
+// Trazas de entrada de Puya: grabar en vivo, reproducir fuera de Rack
+//
+// Formato del archivo (little-endian):
+//
+//   cabecera  "PUYATRC1", versión (u32), frecuencia de muestreo (f32),
+//             número de señales (u32), longitud (u32) y texto del JSON del
+//             módulo al empezar a grabar
+//   eventos   varint muestras desde el evento anterior, varint id de señal
+//             y varint zigzag de la diferencia entre los bits del valor y
+//             los del valor anterior de la misma señal. El id END_ID (sin
+//             valor) cierra la traza en la muestra siguiente a la última.
+//
+// Sólo se guardan los cambios: una señal quieta no ocupa nada y un reloj
+// cuadrado ocupa dos eventos por periodo. En la primera muestra se guardan
+// todas las señales.
+//
+// PuyaTraceRecorder: el hilo de audio compara cada muestra las señales con
+// su último valor y encola los cambios en un anillo sin locks (un productor,
+// un consumidor) que un hilo propio vacía al archivo. Si el anillo se llena
+// los eventos se descartan y se cuentan: la traza deja de ser fiel. La
+// interfaz pide empezar y parar; el hilo de audio hace el cambio al
+// principio de una muestra. Cada grabación lleva un número de sesión, así
+// que los eventos que el hilo de audio encole tarde de una grabación
+// anterior no se mezclan con la nueva.
+//
+// PuyaTraceReader: lee la cabecera y devuelve los eventos en orden.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct PuyaTrace {
+    static const uint32_t VERSION = 1;
+    static const uint32_t END_ID = 0xFFFF;
+    static const char MAGIC[8];
+
+    // Abre con rutas UTF-8, como las de Rack
+    static std::FILE* open(const std::string& path, const char* mode);
+};
+
+class PuyaTraceRecorder {
+public:
+    static const uint32_t RING_SIZE = 1 << 16;
+
+    explicit PuyaTraceRecorder(unsigned int numSignals)
+        : last(numSignals, 0) {
+        requested.store(0, std::memory_order_relaxed);
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        frames.store(0, std::memory_order_relaxed);
+        dropped.store(0, std::memory_order_relaxed);
+        finished.store(true, std::memory_order_relaxed);
+        abort.store(false, std::memory_order_relaxed);
+    }
+
+    ~PuyaTraceRecorder();
+
+    PuyaTraceRecorder(const PuyaTraceRecorder&) = delete;
+    PuyaTraceRecorder& operator=(const PuyaTraceRecorder&) = delete;
+
+    // Interfaz: escribe la cabecera y arranca el hilo de escritura. Una
+    // grabación anterior que no llegó a cerrarse (motor en pausa) se abandona.
+    bool start(const std::string& path, float sampleRate, const std::string& state);
+    void stop() { requested.store(0, std::memory_order_release); }
+
+    bool isRecording() const { return requested.load(std::memory_order_relaxed) != 0; }
+    const std::string& path() const { return filePath; }
+    uint64_t recordedFrames() const { return frames.load(std::memory_order_relaxed); }
+    uint64_t droppedEvents() const { return dropped.load(std::memory_order_relaxed); }
+
+    // Audio, al principio de cada muestra: true si hay que grabarla
+    bool beginFrame() {
+        uint32_t want = requested.load(std::memory_order_acquire);
+        if (want != active) {
+            if (want) {
+                fresh = true;
+                frame = 0;
+                dropped.store(0, std::memory_order_relaxed);
+            } else {
+                push(active, END_ID_EVENT, 0.0f);
+            }
+            active = want;
+        }
+        return active != 0;
+    }
+
+    void signal(unsigned int id, float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        if (!fresh && bits == last[id]) return;
+        last[id] = bits;
+        push(active, static_cast<uint16_t>(id), value);
+    }
+
+    void endFrame() {
+        fresh = false;
+        frame++;
+        frames.store(frame, std::memory_order_relaxed);
+    }
+
+private:
+    static const uint16_t END_ID_EVENT = static_cast<uint16_t>(PuyaTrace::END_ID);
+
+    struct Event {
+        uint64_t frame;
+        uint32_t session;
+        uint16_t id;
+        float value;
+    };
+
+    // Estado del hilo de audio
+    uint32_t active = 0;
+    uint64_t frame = 0;
+    bool fresh = false;
+    std::vector<uint32_t> last;
+
+    // Anillo: head lo avanza el audio, tail el hilo de escritura. Se
+    // reserva en la primera grabación y ya no cambia.
+    std::vector<Event> ring;
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+
+    std::atomic<uint32_t> requested;  // sesión pedida por la interfaz (0 = parar)
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> dropped;
+    std::atomic<bool> finished;       // el hilo de escritura cerró el archivo
+    std::atomic<bool> abort;
+
+    // Estado de la interfaz
+    uint32_t sessions = 0;
+    std::string filePath;
+    std::thread writer;
+
+    void push(uint32_t session, uint16_t id, float value) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= RING_SIZE) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        Event& e = ring[h & (RING_SIZE - 1)];
+        e.frame = frame;
+        e.session = session;
+        e.id = id;
+        e.value = value;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    void run(std::FILE* file, uint32_t session, unsigned int numSignals);
+};
+
+class PuyaTraceReader {
+public:
+    float sampleRate = 0.0f;
+    unsigned int numSignals = 0;
+    std::string state;
+
+    PuyaTraceReader() {}
+    ~PuyaTraceReader() { close(); }
+
+    PuyaTraceReader(const PuyaTraceReader&) = delete;
+    PuyaTraceReader& operator=(const PuyaTraceReader&) = delete;
+
+    // Lee la cabecera; false si no es una traza de esta versión
+    bool open(const std::string& path);
+    void close();
+
+    // Siguiente cambio de señal; false al llegar a END (o al final de un
+    // archivo truncado), y entonces end() es el número de muestras
+    bool next(uint64_t& frame, unsigned int& id, float& value);
+    uint64_t end() const { return frame; }
+
+private:
+    std::FILE* file = nullptr;
+    uint64_t frame = 0;
+    std::vector<uint32_t> last;
+
+    bool readVarint(uint64_t& x);
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+// Análisis rítmico de un patrón empaquetado
+//
+// Densidad, regularidad y síncopa de los n primeros pasos de una máscara
+// de pasos. Recorren sólo los hits (ctz) o n pasos como mucho, así que se
+// calculan una vez por regeneración y se guardan.
+
+#include <cmath>
+
+namespace rhythm {
+
+// Hits por paso
+template <typename Mask>
+inline float density(const Mask& mask, unsigned int n) {
+    if (n == 0) return 0.0f;
+    return static_cast<float>((mask & Mask::firstSteps(n)).count()) / n;
+}
+
+// Regularidad: 1 para los patrones máximamente regulares (euclidianos) y
+// 0 con todos los hits juntos. Compara la desviación de los intervalos
+// entre hits respecto a n/k con la mínima y la máxima posibles.
+template <typename Mask>
+inline float evenness(const Mask& mask, unsigned int n) {
+    Mask steps = mask & Mask::firstSteps(n);
+    unsigned int k = steps.count();
+    if (k < 2 || k >= n) return 1.0f;
+
+    const float ideal = static_cast<float>(n) / k;
+    float deviation = 0.0f;
+    int first = -1, previous = -1;
+    steps.forEach([&](unsigned int i) {
+        if (previous >= 0) deviation += std::fabs(static_cast<float>(i - previous) - ideal);
+        else first = i;
+        previous = i;
+    });
+    deviation += std::fabs(static_cast<float>(first + n - previous) - ideal);
+
+    unsigned int q = n / k, r = n % k;
+    float minDeviation = r * (q + 1 - ideal) + (k - r) * (ideal - q);
+    float maxDeviation = 2.0f * (k - 1) * (ideal - 1.0f);
+    if (maxDeviation <= minDeviation) return 1.0f;
+    float e = (maxDeviation - deviation) / (maxDeviation - minDeviation);
+    return (e < 0.0f) ? 0.0f : (e > 1.0f) ? 1.0f : e;
+}
+
+// Peso métrico binario: ceros finales del índice; el paso 0 es el más fuerte
+inline unsigned int metricWeight(unsigned int i) {
+    return i ? __builtin_ctz(i) : 8;
+}
+
+// Síncopa (simplificación de Longuet-Higgins y Lee): cada hit seguido de un
+// silencio en un paso de mayor peso suma la diferencia de pesos. Se
+// normaliza con la suma de todas las subidas de peso del ciclo.
+template <typename Mask>
+inline float syncopation(const Mask& mask, unsigned int n) {
+    if (n < 2) return 0.0f;
+    Mask first = Mask::firstSteps(n);
+    Mask steps = mask & first;
+
+    // bit i = hit en el paso siguiente (i + 1 módulo n)
+    Mask next = steps.shiftDown();
+    next.set(n - 1, steps[0]);
+
+    unsigned int s = 0;
+    (steps & ~next).forEach([&](unsigned int i) {
+        unsigned int wi = metricWeight(i);
+        unsigned int wj = metricWeight((i + 1 == n) ? 0 : i + 1);
+        if (wj > wi) s += wj - wi;
+    });
+    if (s == 0) return 0.0f;
+
+    unsigned int maximum = 0;
+    for (unsigned int i = 0; i < n; i++) {
+        unsigned int wi = metricWeight(i);
+        unsigned int wj = metricWeight((i + 1 == n) ? 0 : i + 1);
+        if (wj > wi) maximum += wj - wi;
+    }
+    return static_cast<float>(s) / maximum;
+}
+
+} // namespace rhythm
@@ -0,0 +1,202 @@
+#pragma once
+
+// Máscara de pasos empaquetada en palabras de máquina
+//
+// StepMask<N> guarda un bit por paso para ciclos de hasta N pasos:
+// 32 y 64 pasos usan una sola palabra, 128 pasos usan dos. Leer o escribir
+// un paso cuesta lo mismo en las tres especializaciones y las operaciones
+// sobre la máscara completa recorren como mucho dos palabras.
+
+#include <cstdint>
+
+template <typename T, unsigned int WORDS>
+struct WordMask {
+    typedef T word_t;
+    static const unsigned int WORD_BITS = sizeof(T) * 8;
+    static const unsigned int NUM_WORDS = WORDS;
+    static const unsigned int SIZE = WORD_BITS * WORDS;
+
+    T w[WORDS] = {};
+
+    static unsigned int wordIndex(unsigned int i) { return (WORDS == 1) ? 0 : i / WORD_BITS; }
+    static T bit(unsigned int i) { return T(1) << (i % WORD_BITS); }
+
+    bool operator[](unsigned int i) const { return (w[wordIndex(i)] & bit(i)) != 0; }
+
+    void set(unsigned int i, bool value = true) {
+        if (value) w[wordIndex(i)] |= bit(i);
+        else w[wordIndex(i)] &= ~bit(i);
+    }
+
+    T word(unsigned int i) const { return w[i]; }
+    void setWord(unsigned int i, T value) { w[i] = value; }
+
+    void reset() {
+        for (unsigned int i = 0; i < WORDS; i++) w[i] = 0;
+    }
+
+    void fill() {
+        for (unsigned int i = 0; i < WORDS; i++) w[i] = ~T(0);
+    }
+
+    bool any() const {
+        T acc = 0;
+        for (unsigned int i = 0; i < WORDS; i++) acc |= w[i];
+        return acc != 0;
+    }
+
+    unsigned int count() const {
+        unsigned int n = 0;
+        for (unsigned int i = 0; i < WORDS; i++) n += __builtin_popcountll(w[i]);
+        return n;
+    }
+
+    WordMask operator&(const WordMask& o) const {
+        WordMask r;
+        for (unsigned int i = 0; i < WORDS; i++) r.w[i] = w[i] & o.w[i];
+        return r;
+    }
+
+    WordMask operator|(const WordMask& o) const {
+        WordMask r;
+        for (unsigned int i = 0; i < WORDS; i++) r.w[i] = w[i] | o.w[i];
+        return r;
+    }
+
+    WordMask operator^(const WordMask& o) const {
+        WordMask r;
+        for (unsigned int i = 0; i < WORDS; i++) r.w[i] = w[i] ^ o.w[i];
+        return r;
+    }
+
+    WordMask operator~() const {
+        WordMask r;
+        for (unsigned int i = 0; i < WORDS; i++) r.w[i] = ~w[i];
+        return r;
+    }
+
+    bool operator==(const WordMask& o) const {
+        for (unsigned int i = 0; i < WORDS; i++) {
+            if (w[i] != o.w[i]) return false;
+        }
+        return true;
+    }
+
+    bool operator!=(const WordMask& o) const { return !(*this == o); }
+
+    // Pasos 0..n-1 a 1
+    static WordMask firstSteps(unsigned int n) {
+        WordMask r;
+        for (unsigned int i = 0; i < WORDS; i++) {
+            unsigned int lo = i * WORD_BITS;
+            if (n >= lo + WORD_BITS) r.w[i] = ~T(0);
+            else if (n > lo) r.w[i] = (T(1) << (n - lo)) - 1;
+        }
+        return r;
+    }
+
+    // Desplaza un paso hacia índices mayores (el último paso se pierde)
+    WordMask shiftUp() const {
+        WordMask r;
+        T carry = 0;
+        for (unsigned int i = 0; i < WORDS; i++) {
+            r.w[i] = (w[i] << 1) | carry;
+            carry = w[i] >> (WORD_BITS - 1);
+        }
+        return r;
+    }
+
+    // Desplaza un paso hacia índices menores (el paso 0 se pierde)
+    WordMask shiftDown() const {
+        WordMask r;
+        T carry = 0;
+        for (unsigned int i = WORDS; i-- > 0;) {
+            r.w[i] = (w[i] >> 1) | carry;
+            carry = w[i] << (WORD_BITS - 1);
+        }
+        return r;
+    }
+
+    // Llama f(i) para cada paso activo, en orden creciente
+    template <typename F>
+    void forEach(F f) const {
+        for (unsigned int i = 0; i < WORDS; i++) {
+            for (T x = w[i]; x; x &= x - 1) {
+                f(i * WORD_BITS + __builtin_ctzll(x));
+            }
+        }
+    }
+
+    // Apaga el paso activo de menor índice
+    void clearLowest() {
+        for (unsigned int i = 0; i < WORDS; i++) {
+            if (w[i]) {
+                w[i] &= w[i] - 1;
+                return;
+            }
+        }
+    }
+
+    // Máscara con cada bit a 1 con probabilidad p8 / 256. Recorre la
+    // expansión binaria de p8 combinando palabras aleatorias con AND/OR,
+    // así que todos los pasos se sortean a la vez con <= 8 palabras.
+    // RNG: uint64_t rng()
+    template <typename RNG>
+    static WordMask bernoulli(unsigned int p8, RNG rng) {
+        WordMask r;
+        if (p8 >= 256) {
+            r.fill();
+            return r;
+        }
+        if (p8 == 0) return r;
+
+        unsigned int b = __builtin_ctz(p8);
+        for (unsigned int i = 0; i < WORDS; i++) {
+            T acc = static_cast<T>(rng());
+            for (unsigned int j = b + 1; j < 8; j++) {
+                T x = static_cast<T>(rng());
+                acc = ((p8 >> j) & 1) ? (acc | x) : (acc & x);
+            }
+            r.w[i] = acc;
+        }
+        return r;
+    }
+};
+
+template <unsigned int N>
+struct StepMask;
+
+template <>
+struct StepMask<32> : WordMask<uint32_t, 1> {
+    StepMask() {}
+    StepMask(const WordMask<uint32_t, 1>& m) : WordMask<uint32_t, 1>(m) {}
+};
+
+template <>
+struct StepMask<64> : WordMask<uint64_t, 1> {
+    StepMask() {}
+    StepMask(const WordMask<uint64_t, 1>& m) : WordMask<uint64_t, 1>(m) {}
+};
+
+template <>
+struct StepMask<128> : WordMask<uint64_t, 2> {
+    StepMask() {}
+    StepMask(const WordMask<uint64_t, 2>& m) : WordMask<uint64_t, 2>(m) {}
+};
+
+// Copia una máscara de otro ancho: los pasos que no caben se pierden y
+// los que faltan quedan a 0. Trabaja por bloques de 32 pasos, el ancho
+// mínimo.
+template <unsigned int TO, unsigned int FROM>
+StepMask<TO> resizeMask(const StepMask<FROM>& from) {
+    typedef StepMask<TO> To;
+    typedef StepMask<FROM> From;
+    To to;
+    unsigned int n = (TO < FROM) ? TO : FROM;
+    for (unsigned int i = 0; i < n; i += 32) {
+        uint64_t block = (static_cast<uint64_t>(from.word(i / From::WORD_BITS)) >> (i % From::WORD_BITS)) & 0xffffffffu;
+        unsigned int j = i / To::WORD_BITS;
+        to.setWord(j, to.word(j) | static_cast<typename To::word_t>(block << (i % To::WORD_BITS)));
+    }
+    return to;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// Rutas de archivo en Windows
+//
+// Rack trabaja con rutas UTF-8; las API de archivos de Windows (_wfopen,
+// CreateFileW) las quieren en UTF-16. PatternBank.cpp y PuyaTrace.cpp
+// incluyen este archivo en lugar de <windows.h> y convierten con
+// widePath(). En el resto de sistemas no define nada.
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <string>
+
+// Vacía si la ruta no se puede convertir
+inline std::wstring widePath(const std::string& path) {
+    int n = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    if (n <= 0) return std::wstring();
+    std::wstring wpath(n, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wpath[0], n);
+    wpath.resize(n - 1);
+    return wpath;
+}
+#endif
@@ -0,0 +1,78 @@
+// Verificación diferencial de los generadores contra el corpus dorado
+//
+// Compila el motor de patrones de Puya sin Rack para las tres longitudes
+// (32, 64 y 128 pasos) y compara cada una con los corpus de PatternCorpus.hpp
+// que caben en ella. `make test`.
+
+#include "PatternCorpus.hpp"
+#include "PatternEngine.hpp"
+#include <cstdio>
+
+// Adaptador del motor de Puya a la interfaz del corpus
+template <unsigned int MAX_LEN>
+static corpus::Pattern renderEngine(corpus::Style style, const corpus::Tuple& t) {
+  typedef PatternEngine<MAX_LEN> Engine;
+  static Bjorklund euclid, euclid2;
+  std::vector<bool> seq0, acc0;
+  typename Engine::Mask sequence, accents;
+
+  switch (style) {
+    case corpus::EUCLIDEAN:
+      Engine::euclidean(t.l, t.k, t.a, euclid, euclid2, seq0, acc0);
+      break;
+    case corpus::FIBONACCI:
+      Engine::fibonacci(t.l, t.k, t.a, seq0, acc0);
+      break;
+    default:
+      Engine::linear(t.l, t.k, t.a, seq0, acc0);
+      break;
+  }
+  Engine::distributeAccents(seq0, acc0, t.l, t.k, t.a, t.s, t.r, t.p, sequence, accents);
+
+  // Todas las palabras de las máscaras, incluidos los bits fuera del ciclo
+  typedef typename Engine::Mask::word_t Word;
+  const unsigned int split = sizeof(Word) / sizeof(uint32_t);
+  corpus::Pattern out = {};
+  for (unsigned int i = 0; i < Engine::Mask::NUM_WORDS; i++) {
+    for (unsigned int j = 0; j < split; j++) {
+      out.seq[i * split + j] = static_cast<uint32_t>(static_cast<uint64_t>(sequence.word(i)) >> (32 * j));
+      out.acc[i * split + j] = static_cast<uint32_t>(static_cast<uint64_t>(accents.word(i)) >> (32 * j));
+    }
+  }
+  return out;
+}
+
+static void printPattern(const uint32_t* seq, const uint32_t* acc) {
+  for (unsigned int i = corpus::PATTERN_WORDS; i-- > 0;) std::printf("%08x", seq[i]);
+  std::printf("/");
+  for (unsigned int i = corpus::PATTERN_WORDS; i-- > 0;) std::printf("%08x", acc[i]);
+}
+
+template <unsigned int MAX_LEN>
+static bool verifyEngine() {
+  bool ok = true;
+  for (unsigned int w = 0; w < corpus::NUM_WIDTHS && corpus::WIDTHS[w] <= MAX_LEN; w++) {
+    unsigned int width = corpus::WIDTHS[w];
+    corpus::Mismatch m;
+    if (corpus::verify(width, renderEngine<MAX_LEN>, &m)) {
+      std::printf("motor de %u pasos: bit-idéntico al corpus de %u\n", MAX_LEN, width);
+      continue;
+    }
+    std::printf("motor de %u pasos: distinto al corpus de %u (estilo %d, l=%u k=%u a=%u s=%u r=%u p=%u): ",
+                MAX_LEN, width, m.style, m.tuple.l, m.tuple.k, m.tuple.a, m.tuple.s, m.tuple.r, m.tuple.p);
+    printPattern(m.actual.seq, m.actual.acc);
+    std::printf(" != ");
+    printPattern(m.expected.seq, m.expected.acc);
+    std::printf("\n");
+    ok = false;
+  }
+  return ok;
+}
+
+int main() {
+  bool ok = true;
+  ok &= verifyEngine<32>();
+  ok &= verifyEngine<64>();
+  ok &= verifyEngine<128>();
+  return ok ? 0 : 1;
+}